@@ -1335,6 +1335,9 @@ void AM_Drawer (void)
 {
     if (!automapactive) return;
 
+    // screens[0] can flip between frames
+    fb = screens[0];
+
     AM_clearFB(BACKGROUND);
     if (grid)
         AM_drawGrid(GRIDCOLORS);
@@ -61,6 +61,7 @@ rcsid[] = "$Id: d_main.c,v 1.8 1997/02/03 22:45:09 b1 Exp $";
 #include "m_argv.h"
 #include "m_misc.h"
 #include "m_menu.h"
+#include "m_bench.h"
 
 #include "i_system.h"
 #include "i_sound.h"
@@ -248,7 +249,9 @@ void D_Display (void)
             redrawsbar = true;
         if (inhelpscreensstate && !inhelpscreens)
             redrawsbar = true;              // just put away the help screen
+        M_BenchBegin (bench_status);
         ST_Drawer (viewheight == 200, redrawsbar );
+        M_BenchEnd (bench_status);
         fullscreen = viewheight == 200;
         break;
 
@@ -324,7 +327,9 @@ void D_Display (void)
     // normal update
     if (!wipe)
     {
+        M_BenchBegin (bench_blit);
         I_FinishUpdate ();              // page flip or blit buffer
+        M_BenchEnd (bench_blit);
         return;
     }
 
@@ -337,6 +342,8 @@ void D_Display (void)
     {
         do
         {
+            // the new level's graphics load while the wipe waits
+            R_PrefetchLumps (0);
             nowtime = I_GetTime ();
             tics = nowtime - wipestart;
         } while (!tics);
@@ -345,7 +352,9 @@ void D_Display (void)
                                , 0, 0, SCREENWIDTH, SCREENHEIGHT, tics);
         I_UpdateNoBlit ();
         M_Drawer ();                            // menu is drawn even on top of wipes
+        M_BenchBegin (bench_blit);
         I_FinishUpdate ();                      // page flip or blit buffer
+        M_BenchEnd (bench_blit);
     } while (!done);
 }
 
@@ -387,7 +396,9 @@ void D_DoomLoop (void)
             if (advancedemo)
                 D_DoAdvanceDemo ();
             M_Ticker ();
+            M_BenchBegin (bench_ticker);
             G_Ticker ();
+            M_BenchEnd (bench_ticker);
             gametic++;
             maketic++;
         }
@@ -400,6 +411,10 @@ void D_DoomLoop (void)
 
         // Update display, next frame, with current state.
         D_Display ();
+        M_BenchFrame ();
+
+        // a slice of whatever the level still has to load
+        R_PrefetchLumps (PREFETCHUS);
 
 #ifndef SNDSERV
         // Sound mixing for the buffer is snychronous.
@@ -34,6 +34,7 @@ rcsid[] = "$Id: d_net.c,v 1.3 1997/02/03 22:01:47 b1 Exp $";
 #include "g_game.h"
 #include "doomdef.h"
 #include "doomstat.h"
+#include "r_data.h"
 
 
 #define NCMD_EXIT               0x80000000
@@ -716,6 +717,9 @@ void TryRunTics (void)
     // wait for new tics if needed
     while (lowtic < gametic/ticdup + counts)
     {
+        // idle time, load some graphics
+        R_PrefetchLumps (0);
+
         NetUpdate ();
         lowtic = MAXINT;
 
@@ -38,6 +38,34 @@
 #define SDL_WRITE_FB      2102
 #define SDL_PULL_EVENTS   2103
 #define SDL_SHUTDOWN      2104
+#define SDL_WRITE_FB_RECT 2105
+#define SDL_FB_FENCE      2106
+#define SDL_EVENT_RING    2107
+#define SDL_LOAD_PALETTES 2108
+#define SDL_SELECT_PALETTE 2109
+
+// SDL_INIT capabilities: the mask requested is passed in a4,
+//  a host that knows them answers SDL_CAP_MAGIC | granted bits.
+// SDL_WRITE_FB_RECT takes an array of { y, rows, rlesize, data }
+//  words in a0 and their count in a1; each updates rows y to
+//  y+rows-1 of the host's copy of the frame, from raw bytes or,
+//  when rlesize is not 0, from (run length, color) byte pairs.
+// With SDL_CAP_ASYNC both writes return at once and the host reads
+//  the data later; SDL_FB_FENCE returns in a0 how many writes it
+//  is done with, until then their memory must not be touched.
+#define SDL_CAP_MAGIC     0x53444c00
+#define SDL_CAP_RECT      1
+#define SDL_CAP_RLE       2
+#define SDL_CAP_ASYNC     4
+// With SDL_CAP_EVRING, SDL_EVENT_RING hands the host a ring of
+//  { head, tail, event_t[size] } in a0 and its size in a1: the
+//  host stores ready made events (KEY_* codes, mouse deltas << 2)
+//  and bumps head, the game reads them and bumps tail.
+#define SDL_CAP_EVRING    8
+// With SDL_CAP_PALSEL, SDL_LOAD_PALETTES gives the host a0 packed
+//  0xRRGGBB palettes of 256 entries, a1 of them, to keep, and
+//  SDL_SELECT_PALETTE makes palette a0 of those the current one.
+#define SDL_CAP_PALSEL    16
 
 // DOOM
 
@@ -276,12 +276,14 @@ wipe_ScreenWipe
 
     void V_MarkRect(int, int, int, int);
 
+    // screens[0] can flip between calls
+    wipe_scr = screens[0];
+
     // initial stuff
     if (!go)
     {
         go = 1;
         // wipe_scr = (byte *) Z_Malloc(width*height, PU_STATIC, 0); // DEBUG
-        wipe_scr = screens[0];
         (*wipes[wipeno*3])(width, height, ticks);
     }
 
@@ -33,6 +33,7 @@ static const char __attribute__((unused)) rcsid[] = "$Id: g_game.c,v 1.8 1997/02
 #include "f_finale.h"
 #include "i_system.h"
 #include "m_argv.h"
+#include "m_bench.h"
 #include "m_menu.h"
 #include "m_misc.h"
 #include "m_random.h"
@@ -68,7 +69,6 @@ static const char __attribute__((unused)) rcsid[] = "$Id: g_game.c,v 1.8 1997/02
 
 #include "g_game.h"
 
-#define SAVEGAMESIZE   0x2c000
 #define SAVESTRINGSIZE 24
 
 boolean G_CheckDemoStatus(void);
@@ -127,14 +127,12 @@ byte *demo_p;
 byte *demoend;
 boolean singledemo; // quit after playing a demo from cmdline
 
-boolean precache = true; // if true, load all graphics at start
+boolean precache = true; // if true, prefetch the level graphics
 
 wbstartstruct_t wminfo; // parms for world map / intermission
 
 short consistancy[MAXPLAYERS][BACKUPTICS];
 
-byte *savebuffer;
-
 //
 // controls (have defaults)
 //
@@ -430,6 +428,8 @@ void G_DoLoadLevel(void) {
     P_SetupLevel(gameepisode, gamemap, 0, gameskill);
     displayplayer = consoleplayer; // view the guy you are playing
     starttime = I_GetTime();
+    if (timingdemo)
+        M_BenchStart();
     gameaction = ga_nothing;
     Z_CheckHeap();
 
@@ -1049,45 +1049,47 @@ void G_DoLoadGame(void) {
     int i;
     int a, b, c;
     char vcheck[VERSIONSIZE];
+    char name[SAVESTRINGSIZE];
 
     gameaction = ga_nothing;
 
-    M_ReadFile(savename, &savebuffer);
-    save_p = savebuffer + SAVESTRINGSIZE;
+    if (!P_OpenSaveGame(savename, false))
+        return;
 
     // skip the description field
+    P_ReadBytes(name, SAVESTRINGSIZE);
+    P_ReadBytes(name, VERSIONSIZE);
+    name[VERSIONSIZE - 1] = 0;
     memset(vcheck, 0, sizeof(vcheck));
-    sprintf(vcheck, "version %i", VERSION);
-    if (strcmp((char *) save_p, vcheck))
+    sprintf(vcheck, "version %i.%i", VERSION, SAVEGAMEFORMAT);
+    if (strcmp(name, vcheck)) {
+        P_CloseSaveGame();
         return; // bad version
-    save_p += VERSIONSIZE;
+    }
 
-    gameskill = *save_p++;
-    gameepisode = *save_p++;
-    gamemap = *save_p++;
+    gameskill = P_ReadByte();
+    gameepisode = P_ReadByte();
+    gamemap = P_ReadByte();
     for (i = 0; i < MAXPLAYERS; i++)
-        playeringame[i] = *save_p++;
+        playeringame[i] = P_ReadByte();
 
     // load a base level
     G_InitNew(gameskill, gameepisode, gamemap);
 
     // get the times
-    a = *save_p++;
-    b = *save_p++;
-    c = *save_p++;
+    a = P_ReadByte();
+    b = P_ReadByte();
+    c = P_ReadByte();
     leveltime = (a << 16) + (b << 8) + c;
 
     // dearchive all the modifications
-    P_UnArchivePlayers();
-    P_UnArchiveWorld();
-    P_UnArchiveThinkers();
-    P_UnArchiveSpecials();
+    P_UnArchiveGame();
 
-    if (*save_p != 0x1d)
+    if (P_ReadByte() != 0x1d)
         I_Error("Bad savegame");
 
     // done
-    Z_Free(savebuffer);
+    P_CloseSaveGame();
 
     if (setsizeneeded)
         R_ExecuteSetViewSize();
@@ -1107,46 +1109,45 @@ void G_SaveGame(int slot, char *description) {
     sendsave = true;
 }
 
+//
+// G_DoSaveGame
+// The savegame is streamed straight to the file,
+// so it has no size limit and needs no buffer.
+//
 void G_DoSaveGame(void) {
     char name[100];
     char name2[VERSIONSIZE];
     char *description;
-    int length;
     int i;
 
     sprintf(name, SAVEGAMENAME "%d.dsg", savegameslot);
     description = savedescription;
 
-    save_p = savebuffer = screens[1] + 0x4000;
+    gameaction = ga_nothing;
 
-    memcpy(save_p, description, SAVESTRINGSIZE);
-    save_p += SAVESTRINGSIZE;
+    if (!P_OpenSaveGame(name, true))
+        return;
+
+    P_WriteBytes(description, SAVESTRINGSIZE);
     memset(name2, 0, sizeof(name2));
-    sprintf(name2, "version %i", VERSION);
-    memcpy(save_p, name2, VERSIONSIZE);
-    save_p += VERSIONSIZE;
+    sprintf(name2, "version %i.%i", VERSION, SAVEGAMEFORMAT);
+    P_WriteBytes(name2, VERSIONSIZE);
 
-    *save_p++ = gameskill;
-    *save_p++ = gameepisode;
-    *save_p++ = gamemap;
+    P_WriteByte(gameskill);
+    P_WriteByte(gameepisode);
+    P_WriteByte(gamemap);
     for (i = 0; i < MAXPLAYERS; i++)
-        *save_p++ = playeringame[i];
-    *save_p++ = leveltime >> 16;
-    *save_p++ = leveltime >> 8;
-    *save_p++ = leveltime;
-
-    P_ArchivePlayers();
-    P_ArchiveWorld();
-    P_ArchiveThinkers();
-    P_ArchiveSpecials();
-
-    *save_p++ = 0x1d; // consistancy marker
-
-    length = save_p - savebuffer;
-    if (length > SAVEGAMESIZE)
-        I_Error("Savegame buffer overrun");
-    M_WriteFile(name, savebuffer, length);
-    gameaction = ga_nothing;
+        P_WriteByte(playeringame[i]);
+    P_WriteByte(leveltime >> 16);
+    P_WriteByte(leveltime >> 8);
+    P_WriteByte(leveltime);
+
+    P_ArchiveGame();
+
+    P_WriteByte(0x1d); // consistancy marker
+
+    if (!P_CloseSaveGame())
+        return;
     savedescription[0] = 0;
 
     players[consoleplayer].message = GGSAVED;
@@ -1396,10 +1397,8 @@ void G_DoPlayDemo(void) {
         netdemo = true;
     }
 
-    // don't spend a lot of time in loadlevel
-    precache = false;
+    // precaching only queues the graphics, it costs no time here
     G_InitNew(skill, episode, map);
-    precache = true;
 
     usergame = false;
     demoplayback = true;
@@ -1433,6 +1432,7 @@ boolean G_CheckDemoStatus(void) {
 
     if (timingdemo) {
         endtime = I_GetTime();
+        M_BenchReport(endtime - starttime);
         I_Error("timed %i gametics in %i realtics", gametic, endtime - starttime);
     }
 
@@ -40,11 +40,22 @@ void I_Init (void);
 // for the zone management.
 byte*   I_ZoneBase (int *size);
 
+// Called by W_AddFile, and for the texture cache.
+// Returns the whole contents of an open WAD file
+// in addressable memory (mmap, ROM, flash...),
+// or NULL to have lumps read with lseek/read.
+// The mapping must stay valid until exit.
+byte*   I_MapWadFile (int handle, int size);
+
 
 // Called by D_DoomLoop,
 // returns current time in tics.
 int I_GetTime (void);
 
+// Called by the timedemo benchmark,
+// returns a free running microsecond count.
+int I_GetTimeUS (void);
+
 
 //
 // Called by D_DoomLoop,
@@ -64,6 +75,10 @@ void I_StartFrame (void);
 // Can call D_PostEvent.
 void I_StartTic (void);
 
+// Called by I_InitGraphics when the host offers an
+// event ring, I_StartTic then reads events from it.
+void I_InitEventRing (void);
+
 // Asynchronous interrupt functions should maintain private queues
 // that are read by the synchronous functions
 // to be converted into events.
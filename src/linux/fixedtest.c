@@ -0,0 +1,144 @@
+/*
+ * fixedtest.c
+ *
+ * Checks FixedDiv2 against the 64 bit divide it replaced, over
+ * edge values and random pairs, then times both.
+ *
+ * Usage: fixedtest [random pairs]
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "m_fixed.h"
+
+#define BENCHPAIRS 4096
+#define BENCHLOOPS 1000
+
+static volatile fixed_t sink;
+static int failures;
+
+/* FixedDiv2 calls it on a zero divisor, never passed here */
+void I_Error(char *error, ...)
+{
+    fprintf(stderr, "Error: %s\n", error);
+    exit(1);
+}
+
+static fixed_t FixedDiv64(fixed_t a, fixed_t b)
+{
+    return (fixed_t) (((long long) a << 16) / (long long) b);
+}
+
+/* xorshift32, so runs are repeatable on every libc */
+static uint32_t rngstate = 0x12345678;
+
+static uint32_t rng(void)
+{
+    rngstate ^= rngstate << 13;
+    rngstate ^= rngstate >> 17;
+    rngstate ^= rngstate << 5;
+    return rngstate;
+}
+
+/* Full range values as well as small ones, which are
+ * where the quotient and remainder edge cases are */
+static fixed_t rngvalue(void)
+{
+    uint32_t v = rng();
+
+    switch (rng() & 3) {
+    case 0:
+        return v;
+    case 1:
+        return (int32_t) v >> (rng() & 31);
+    case 2:
+        return (int32_t) (v & 0xffff) - 0x8000;
+    default:
+        return (int32_t) v >> 16 << 16;
+    }
+}
+
+static void check(fixed_t a, fixed_t b)
+{
+    fixed_t got, want;
+
+    if (!b)
+        return;
+
+    got = FixedDiv2(a, b);
+    want = FixedDiv64(a, b);
+
+    if (got != want && failures++ < 10)
+        printf("FixedDiv2(%d, %d) = %d, expected %d\n", a, b, got, want);
+}
+
+static double bench(fixed_t (*div)(fixed_t, fixed_t),
+                    const fixed_t *a, const fixed_t *b)
+{
+    clock_t start = clock();
+    fixed_t sum = 0;
+    int i, j;
+
+    for (j = 0; j < BENCHLOOPS; j++)
+        for (i = 0; i < BENCHPAIRS; i++)
+            sum += div(a[i], b[i]);
+    sink = sum;
+
+    return (double) (clock() - start) / CLOCKS_PER_SEC
+        * 1e9 / ((double) BENCHLOOPS * BENCHPAIRS);
+}
+
+int main(int argc, char *argv[])
+{
+    static const fixed_t edges[] = {
+        0, 1, -1, 2, -2, 3, 7, 0xffff, 0x10000, -0x10000, 0x10001,
+        0x7fff, 0x8000, 0x8001, 0xfffe, 0x1ffff, 0x7fffffff,
+        -0x7fffffff, (fixed_t) 0x80000000, 0x40000000, 0x3fffffff,
+        0x12345678, -0x12345678, 0x00ff00ff, 0x7ffffffe,
+    };
+    static fixed_t benchb[BENCHPAIRS], bencha[BENCHPAIRS];
+    int nedges = sizeof(edges) / sizeof(edges[0]);
+    long count = argc > 1 ? atol(argv[1]) : 50000000;
+    long n;
+    int i, j, k;
+
+    /* Edge values, their neighbours and every pair of them */
+    for (i = 0; i < nedges; i++)
+        for (j = 0; j < nedges; j++)
+            for (k = -1; k <= 1; k++) {
+                check(edges[i] + k, edges[j]);
+                check(edges[i], edges[j] + k);
+            }
+
+    for (n = 0; n < count; n++)
+        check(rngvalue(), rngvalue());
+
+    printf("%ld random pairs, %d mismatches\n", count, failures);
+
+    /* Only pairs FixedDiv lets through, as the game calls it */
+    for (i = 0; i < BENCHPAIRS; i++) {
+        do {
+            bencha[i] = rngvalue();
+            benchb[i] = rngvalue();
+        } while (!benchb[i] || (abs(bencha[i]) >> 14) >= abs(benchb[i]));
+    }
+
+    printf("FixedDiv2 %.1f ns, 64 bit divide %.1f ns\n",
+           bench(FixedDiv2, bencha, benchb),
+           bench(FixedDiv64, bencha, benchb));
+
+    return failures != 0;
+}
@@ -0,0 +1,136 @@
+/*
+ * i_system.c
+ *
+ * System support code, headless Linux host build
+ *
+ * Copyright (C) 1993-1996 by id Software, Inc.
+ * Copyright (C) 2021 Sylvain Munaut
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "../doomdef.h"
+#include "doomstat.h"
+
+#include "../d_event.h"
+#include "d_main.h"
+#include "g_game.h"
+#include "i_sound.h"
+#include "i_video.h"
+#include "m_misc.h"
+
+#include "i_system.h"
+
+/* Wall clock time base, both timers count from the first call */
+static struct timespec basetime;
+
+static uint64_t I_ElapsedNS(void) {
+    struct timespec ts;
+
+    if (!basetime.tv_sec && !basetime.tv_nsec)
+        clock_gettime(CLOCK_MONOTONIC, &basetime);
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)(ts.tv_sec - basetime.tv_sec) * 1000000000
+        + ts.tv_nsec - basetime.tv_nsec;
+}
+
+void I_Init(void) {
+    I_ElapsedNS();
+}
+
+byte *I_ZoneBase(int *size) {
+    /* Same 6M as the target, so zone behaviour matches */
+    *size = 6 * 1024 * 1024;
+    return (byte *) malloc(*size);
+}
+
+byte *I_MapWadFile(int handle, int size) {
+    /* Private writable mapping, pages only get copied if touched */
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, handle, 0);
+
+    if (base == MAP_FAILED)
+        return NULL;
+    return (byte *) base;
+}
+
+int I_GetTime(void) {
+    return I_ElapsedNS() * TICRATE / 1000000000;
+}
+
+int I_GetTimeUS(void) {
+    /* Wraps after 71 minutes, callers only take differences */
+    return (int)(uint32_t)(I_ElapsedNS() / 1000);
+}
+
+void I_StartFrame(void) {
+    /* Nothing to do */
+}
+
+void I_StartTic(void) {
+    /* Headless, the only input is the demo */
+}
+
+ticcmd_t *I_BaseTiccmd(void) {
+    static ticcmd_t emptycmd;
+    return &emptycmd;
+}
+
+void I_Quit(void) {
+    D_QuitNetGame();
+    M_SaveDefaults();
+    I_ShutdownGraphics();
+    exit(0);
+}
+
+byte *I_AllocLow(int length) {
+    byte *mem;
+    mem = (byte *) malloc(length);
+    memset(mem, 0, length);
+    return mem;
+}
+
+void I_Tactile(int on, int off, int total) {
+    // UNUSED.
+    on = off = total = 0;
+}
+
+void I_Error(char *error, ...) {
+    va_list argptr;
+
+    // Message first.
+    va_start(argptr, error);
+    fprintf(stderr, "Error: ");
+    vfprintf(stderr, error, argptr);
+    fprintf(stderr, "\n");
+    va_end(argptr);
+
+    fflush(stderr);
+
+    // Shutdown. Here might be other errors.
+    if (demorecording)
+        G_CheckDemoStatus();
+
+    D_QuitNetGame();
+    I_ShutdownGraphics();
+
+    exit(-1);
+}
@@ -0,0 +1,54 @@
+/*
+ * i_video.c
+ *
+ * Video system support code, headless Linux host build
+ *
+ * Copyright (C) 2021 Sylvain Munaut
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <string.h>
+
+#include "../doomdef.h"
+#include "../doomstat.h"
+
+#include "i_system.h"
+#include "i_video.h"
+#include "v_video.h"
+
+/* Frames are drawn into screens[0] as usual and never shown, so
+ * -timedemo times everything but the host side of the blit */
+
+void I_InitGraphics(void) {
+    /* Ok, maybe just set gamma default */
+    usegamma = 1;
+}
+
+void I_ShutdownGraphics(void) {
+}
+
+void I_SetPalette(byte *palette) {
+}
+
+void I_UpdateNoBlit(void) {
+}
+
+void I_FinishUpdate(void) {
+}
+
+void I_WaitVBL(int count) {
+}
+
+void I_ReadScreen(byte *scr) {
+    memcpy(scr, screens[0], SCREENHEIGHT * SCREENWIDTH);
+}
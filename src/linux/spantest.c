@@ -0,0 +1,195 @@
+/*
+ * spantest.c
+ *
+ * Checks the packed span drawers against the byte ones over
+ * random spans, then times both over representative lengths.
+ *
+ * Usage: spantest [random spans]
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+#include "r_local.h"
+#include "v_video.h"
+
+#define BENCHSPANS 20000
+#define BENCHLOOPS 20
+
+/* What r_draw.c needs from the rest of the game, the span
+ * drawers only use screens[0] and the view window */
+byte *screens[5];
+int detailshift;
+int centery;
+lighttable_t *colormaps;
+GameMode_t gamemode;
+
+void I_Error(char *error, ...)
+{
+    fprintf(stderr, "Error: %s\n", error);
+    exit(1);
+}
+
+void *Z_Malloc(int size, int tag, void *user)
+{
+    I_Error("Z_Malloc: not in spantest");
+    return NULL;
+}
+
+void *W_CacheLumpName(char *name, int tag)
+{
+    I_Error("W_CacheLumpName: not in spantest");
+    return NULL;
+}
+
+void V_DrawPatch(int x, int y, int scrn, patch_t *patch)
+{
+}
+
+void V_MarkRect(int x, int y, int width, int height)
+{
+}
+
+/* xorshift32, so runs are repeatable on every libc */
+static uint32_t rngstate = 0x12345678;
+
+static uint32_t rng(void)
+{
+    rngstate ^= rngstate << 13;
+    rngstate ^= rngstate >> 17;
+    rngstate ^= rngstate << 5;
+    return rngstate;
+}
+
+static byte source[64 * 64];
+static lighttable_t colormap[256];
+/* A low detail span draws twice its texels doubled, which runs
+ * up to a row past the end, as it always has */
+#define SCREENSIZE (SCREENWIDTH * (SCREENHEIGHT + 1))
+
+static byte screen0[SCREENSIZE];
+static byte screen1[SCREENSIZE];
+
+typedef struct {
+    int y, x1, x2;
+    fixed_t xfrac, yfrac, xstep, ystep;
+} span_t;
+
+static void randomspan(span_t *span, int low, int length)
+{
+    int width = low ? SCREENWIDTH / 2 : SCREENWIDTH;
+
+    if (length <= 0 || length > width)
+        length = rng() % width + 1;
+
+    span->y = rng() % SCREENHEIGHT;
+    span->x1 = rng() % (width - length + 1);
+    span->x2 = span->x1 + length - 1;
+    span->xfrac = rng();
+    span->yfrac = rng();
+    span->xstep = (int32_t) rng() >> (rng() % 16 + 8);
+    span->ystep = (int32_t) rng() >> (rng() % 16 + 8);
+}
+
+static void draw(void (*func)(void), const span_t *span)
+{
+    ds_y = span->y;
+    ds_x1 = span->x1;
+    ds_x2 = span->x2;
+    ds_xfrac = span->xfrac;
+    ds_yfrac = span->yfrac;
+    ds_xstep = span->xstep;
+    ds_ystep = span->ystep;
+    func();
+}
+
+static double bench(void (*func)(void), const span_t *spans, int pixels)
+{
+    clock_t start = clock();
+    int i, j;
+
+    for (j = 0; j < BENCHLOOPS; j++)
+        for (i = 0; i < BENCHSPANS; i++)
+            draw(func, &spans[i]);
+
+    return (double) (clock() - start) / CLOCKS_PER_SEC
+        * 1e9 / ((double) BENCHLOOPS * pixels);
+}
+
+int main(int argc, char *argv[])
+{
+    static const int lengths[] = { 8, 16, 32, 64, 128, 320 };
+    static span_t spans[BENCHSPANS];
+    long count = argc > 1 ? atol(argv[1]) : 2000000;
+    long n;
+    int failures = 0;
+    int low, i, j, pixels;
+    span_t span;
+
+    for (i = 0; i < 64 * 64; i++)
+        source[i] = rng();
+    for (i = 0; i < 256; i++)
+        colormap[i] = rng();
+
+    ds_source = source;
+    ds_colormap = colormap;
+    viewwindowx = 0;
+    viewwindowy = 0;
+
+    /* Full screen, every alignment and length */
+    for (n = 0; n < count; n++) {
+        low = rng() & 1;
+        randomspan(&span, low, 0);
+
+        memset(screen0, 0, sizeof(screen0));
+        memset(screen1, 0, sizeof(screen1));
+
+        screens[0] = screen0;
+        draw(low ? R_DrawSpanLow : R_DrawSpan, &span);
+        screens[0] = screen1;
+        draw(low ? R_DrawSpanLowPacked : R_DrawSpanPacked, &span);
+
+        if (memcmp(screen0, screen1, sizeof(screen0)) && failures++ < 10)
+            printf("%s span %d..%d at %d differs\n", low ? "low" : "high",
+                   span.x1, span.x2, span.y);
+    }
+
+    printf("%ld random spans, %d mismatches\n", count, failures);
+
+    /* ns per pixel, byte and packed drawers */
+    screens[0] = screen0;
+    for (low = 0; low < 2; low++) {
+        for (j = 0; j < (int) (sizeof(lengths) / sizeof(lengths[0])); j++) {
+            if (low && lengths[j] > SCREENWIDTH / 2)
+                continue;
+
+            pixels = 0;
+            for (i = 0; i < BENCHSPANS; i++) {
+                randomspan(&spans[i], low, lengths[j]);
+                pixels += lengths[j] << low;
+            }
+
+            printf("%s %3d: byte %.2f ns, packed %.2f ns per pixel\n",
+                   low ? "low " : "high", lengths[j],
+                   bench(low ? R_DrawSpanLow : R_DrawSpan, spans, pixels),
+                   bench(low ? R_DrawSpanLowPacked : R_DrawSpanPacked, spans, pixels));
+        }
+    }
+
+    return failures != 0;
+}
@@ -0,0 +1,277 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// $Log:$
+//
+// DESCRIPTION:
+//      Timedemo benchmark.
+//      Times every frame and the main subsystems within
+//       it with I_GetTimeUS, and reports min/avg/p99
+//       frame times and per subsystem totals when the
+//       demo ends, for comparing builds.
+//
+//-----------------------------------------------------------------------------
+
+static const char __attribute__((unused))
+rcsid[] = "$Id:$";
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "doomdef.h"
+#include "doomstat.h"
+
+#include "i_system.h"
+#include "z_zone.h"
+#include "r_main.h"
+
+#ifdef __GNUG__
+#pragma implementation "m_bench.h"
+#endif
+#include "m_bench.h"
+
+
+// Frame times are all kept for p99, in a zone
+//  block that doubles from this many when full.
+#define BENCHFRAMES     8192
+
+// Sort times are kept per power of two sprite
+//  count, the last one taking everything above.
+#define SORTBUCKETS     12
+
+boolean                 benchactive;
+
+static char*            phasenames[NUMBENCHPHASES] =
+{
+    "ticker",
+    "bsp",
+    "planes",
+    "masked",
+    "flush",
+    "sort",
+    "status",
+    "blit"
+};
+
+static unsigned long long phasetime[NUMBENCHPHASES];
+static int              phasestart[NUMBENCHPHASES];
+static int              phaselast[NUMBENCHPHASES];
+
+static int              sortframes[SORTBUCKETS];
+static unsigned long long sorttime[SORTBUCKETS];
+
+static int*             frametimes;
+static int              maxframes;
+static int              numframes;
+static int              framestart;
+static int              minframe;
+static int              maxframe;
+static unsigned long long totalframe;
+
+
+
+//
+// M_BenchStart
+//
+void M_BenchStart (void)
+{
+    int         i;
+
+    if (benchactive)
+        return;
+
+    if (!frametimes)
+    {
+        maxframes = BENCHFRAMES;
+        frametimes = Z_Malloc (maxframes*sizeof(*frametimes),
+                               PU_STATIC, NULL);
+    }
+
+    for (i=0 ; i<NUMBENCHPHASES ; i++)
+        phasetime[i] = 0;
+
+    for (i=0 ; i<SORTBUCKETS ; i++)
+    {
+        sortframes[i] = 0;
+        sorttime[i] = 0;
+    }
+
+    memset (&renderpeaks, 0, sizeof(renderpeaks));
+
+    numframes = 0;
+    minframe = MAXINT;
+    maxframe = 0;
+    totalframe = 0;
+
+    benchactive = true;
+    framestart = I_GetTimeUS ();
+}
+
+
+//
+// M_BenchBegin
+//
+void M_BenchBegin (benchphase_t phase)
+{
+    if (benchactive)
+        phasestart[phase] = I_GetTimeUS ();
+}
+
+
+//
+// M_BenchEnd
+//
+void M_BenchEnd (benchphase_t phase)
+{
+    if (benchactive)
+    {
+        phaselast[phase] = I_GetTimeUS () - phasestart[phase];
+        phasetime[phase] += phaselast[phase];
+    }
+}
+
+
+//
+// M_BenchSorted
+// Bucket 0 is no sprites, bucket n is
+//  1<<(n-1) up to (1<<n)-1 sprites.
+//
+void M_BenchSorted (int count)
+{
+    int         bucket;
+
+    if (!benchactive)
+        return;
+
+    for (bucket=0 ; count && bucket<SORTBUCKETS-1 ; bucket++)
+        count >>= 1;
+
+    sortframes[bucket]++;
+    sorttime[bucket] += phaselast[bench_sort];
+}
+
+
+//
+// M_BenchFrame
+// Frame time is everything between two calls,
+//  tics run, drawing and the blit.
+//
+void M_BenchFrame (void)
+{
+    int         now;
+    int         frame;
+    int*        grown;
+
+    if (!benchactive)
+        return;
+
+    now = I_GetTimeUS ();
+    frame = now - framestart;
+    framestart = now;
+
+    if (numframes == maxframes)
+    {
+        grown = Z_Malloc (2*maxframes*sizeof(*frametimes), PU_STATIC, NULL);
+        memcpy (grown, frametimes, maxframes*sizeof(*frametimes));
+        Z_Free (frametimes);
+        frametimes = grown;
+        maxframes *= 2;
+    }
+    frametimes[numframes++] = frame;
+
+    if (frame < minframe)
+        minframe = frame;
+    if (frame > maxframe)
+        maxframe = frame;
+    totalframe += frame;
+}
+
+
+static int M_CompareFrames (const void* a, const void* b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+
+//
+// M_BenchReport
+//
+void M_BenchReport (int realtics)
+{
+    int         i;
+    int         p99;
+    int         first;
+    unsigned long long accounted;
+
+    if (!benchactive)
+        return;
+
+    benchactive = false;
+
+    p99 = 0;
+    if (numframes)
+    {
+        qsort (frametimes, numframes, sizeof(*frametimes), M_CompareFrames);
+        p99 = frametimes[(numframes*99)/100];
+    }
+    else
+        minframe = 0;
+
+    printf ("{\"gametics\":%i,\"frames\":%i,\"realtics\":%i,"
+            "\"frame_us\":{\"min\":%i,\"avg\":%i,\"p99\":%i,\"max\":%i},"
+            "\"phase_us\":{",
+            gametic, numframes, realtics,
+            minframe,
+            numframes ? (int)(totalframe/numframes) : 0,
+            p99, maxframe);
+
+    accounted = 0;
+    for (i=0 ; i<NUMBENCHPHASES ; i++)
+    {
+        printf ("\"%s\":%llu,", phasenames[i], phasetime[i]);
+
+        // the sort is timed inside masked
+        if (i != bench_sort)
+            accounted += phasetime[i];
+    }
+
+    printf ("\"other\":%llu},",
+            totalframe > accounted ? totalframe - accounted : 0);
+
+    // sort time against the number of sprites sorted,
+    //  keyed by the smallest count in each bucket
+    printf ("\"sort_us\":{");
+    first = 1;
+    for (i=0 ; i<SORTBUCKETS ; i++)
+    {
+        if (!sortframes[i])
+            continue;
+
+        printf ("%s\"%i\":{\"frames\":%i,\"us\":%llu}",
+                first ? "" : ",", i ? 1<<(i-1) : 0,
+                sortframes[i], sorttime[i]);
+        first = 0;
+    }
+    printf ("},");
+
+    // renderer pool high-water marks for the demo
+    printf ("\"peaks\":{\"visplanes\":%i,\"openings\":%i,"
+            "\"drawsegs\":%i,\"vissprites\":%i}}\n",
+            renderpeaks.visplanes, renderpeaks.openings,
+            renderpeaks.drawsegs, renderpeaks.vissprites);
+}
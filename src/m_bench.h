@@ -0,0 +1,72 @@
+// Emacs style mode select   -*- C++ -*-
+//-----------------------------------------------------------------------------
+//
+// $Id:$
+//
+// Copyright (C) 1993-1996 by id Software, Inc.
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// DESCRIPTION:
+//      Timedemo frame and subsystem timing.
+//
+//-----------------------------------------------------------------------------
+
+
+#ifndef __M_BENCH__
+#define __M_BENCH__
+
+#include "doomtype.h"
+
+
+// Timed sections of a frame.
+typedef enum
+{
+    bench_ticker,       // G_Ticker
+    bench_bsp,          // R_RenderBSPNode
+    bench_planes,       // R_DrawPlanes
+    bench_masked,       // R_DrawMasked
+    bench_flush,        // R_FlushView
+    bench_sort,         // R_SortVisSprites, part of masked
+    bench_status,       // ST_Drawer
+    bench_blit,         // I_FinishUpdate
+    NUMBENCHPHASES
+
+} benchphase_t;
+
+
+extern  boolean benchactive;
+
+// Called when a timed demo level starts.
+void    M_BenchStart (void);
+
+// Bracket a timed section, no-ops unless benchmarking.
+void    M_BenchBegin (benchphase_t phase);
+void    M_BenchEnd (benchphase_t phase);
+
+// Files the last bench_sort time under
+//  the number of sprites it sorted.
+void    M_BenchSorted (int count);
+
+// Called once per displayed frame.
+void    M_BenchFrame (void);
+
+// Prints the results as one line of JSON,
+// renderer pool peaks included.
+void    M_BenchReport (int realtics);
+
+
+#endif
+//-----------------------------------------------------------------------------
+//
+// $Log:$
+//
+//-----------------------------------------------------------------------------
@@ -67,12 +67,87 @@ FixedDiv
 
 
 
+//
+// FixedDiv2, 32 bit divide version.
+// (a<<16)/b is a 48 by 32 bit divide, which 32 bit cores
+//  without hardware 64 bit division (rv32im) would hand
+//  to libgcc.  This does it as a two digit long division
+//  (base 65536) with a normalized divisor, using only
+//  32 bit divides.  Results, wrap around of quotients
+//  that don't fit included, match the 64 bit version,
+//  which -DFIXEDDIV64 brings back.
+//
+
 fixed_t
 FixedDiv2
 ( fixed_t       a,
   fixed_t       b )
 {
-#if 1
+#if !defined(FIXEDDIV64)
+    unsigned    n;
+    unsigned    d;
+    unsigned    u1;
+    unsigned    un10;
+    unsigned    un32;
+    unsigned    un21;
+    unsigned    vn1;
+    unsigned    vn0;
+    unsigned    q1;
+    unsigned    q0;
+    unsigned    rhat;
+    int         s;
+
+    if (!b)
+        I_Error("FixedDiv: divide by zero");
+
+    n = a < 0 ? -(unsigned)a : (unsigned)a;
+    d = b < 0 ? -(unsigned)b : (unsigned)b;
+
+    // dividend is (n>>16):(n<<16).  Quotient bits above 32
+    //  only come from the high word and are lost in the
+    //  cast anyway, so just keep the remainder.
+    u1 = (n >> 16) % d;
+
+    // normalize so the top bit of the divisor is set
+    s = __builtin_clz (d);
+    d <<= s;
+    vn1 = d >> 16;
+    vn0 = d & 0xffff;
+
+    un32 = u1 << s;
+    if (s)
+        un32 |= (n << 16) >> (32-s);
+    un10 = (n << 16) << s;
+
+    // first quotient digit
+    q1 = un32 / vn1;
+    rhat = un32 - q1*vn1;
+
+    while (q1 >= 0x10000 || q1*vn0 > ((rhat<<16) | (un10>>16)))
+    {
+        q1--;
+        rhat += vn1;
+        if (rhat >= 0x10000)
+            break;
+    }
+
+    // second quotient digit
+    un21 = (un32<<16) + (un10>>16) - q1*d;
+    q0 = un21 / vn1;
+    rhat = un21 - q0*vn1;
+
+    while (q0 >= 0x10000 || q0*vn0 > ((rhat<<16) | (un10 & 0xffff)))
+    {
+        q0--;
+        rhat += vn1;
+        if (rhat >= 0x10000)
+            break;
+    }
+
+    n = (q1<<16) + q0;
+
+    return (a^b) < 0 ? -n : n;
+#elif 1
     long long c;
     c = ((long long)a<<16) / ((long long)b);
     return (fixed_t) c;
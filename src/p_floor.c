@@ -58,6 +58,9 @@ T_MovePlane
     boolean     flag;
     fixed_t     lastpos;
 
+    // Lines of sight may open or close.
+    P_ClearSightCache ();
+
     switch(floorOrCeiling)
     {
       case 0:
@@ -188,7 +188,7 @@ P_SpawnStrobeFlash
 
     flash = Z_Malloc ( sizeof(*flash), PU_LEVSPEC, 0);
 
-    P_AddThinker (&flash->thinker);
+    P_AddLightThinker (&flash->thinker);
 
     flash->sector = sector;
     flash->darktime = fastOrSlow;
@@ -345,7 +345,7 @@ void P_SpawnGlowingLight(sector_t*      sector)
 
     g = Z_Malloc( sizeof(*g), PU_LEVSPEC, 0);
 
-    P_AddThinker(&g->thinker);
+    P_AddLightThinker(&g->thinker);
 
     g->sector = sector;
     g->minlight = P_FindMinSurroundingLight(sector,sector->lightlevel);
@@ -70,9 +70,13 @@
 // both the head and tail of the thinker list
 extern  thinker_t       thinkercap;
 
+// glowing and strobing lights, run after thinkercap
+extern  thinker_t       lightcap;
+
 
 void P_InitThinkers (void);
 void P_AddThinker (thinker_t* thinker);
+void P_AddLightThinker (thinker_t* thinker);
 void P_RemoveThinker (thinker_t* thinker);
 
 
@@ -174,6 +178,7 @@ extern fixed_t          lowfloor;
 void    P_LineOpening (line_t* linedef);
 
 boolean P_BlockLinesIterator (int x, int y, boolean(*func)(line_t*) );
+line_t** P_BlockLinesInBox (int xl, int yl, int xh, int yh, int* count);
 boolean P_BlockThingsIterator (int x, int y, boolean(*func)(mobj_t*) );
 
 #define PT_ADDLINES             1
@@ -213,6 +218,7 @@ boolean P_TryMove (mobj_t* thing, fixed_t x, fixed_t y);
 boolean P_TeleportMove (mobj_t* thing, fixed_t x, fixed_t y);
 void    P_SlideMove (mobj_t* mo);
 boolean P_CheckSight (mobj_t* t1, mobj_t* t2);
+void    P_ClearSightCache (void);
 void    P_UseLines (player_t* player);
 
 boolean P_ChangeSector (sector_t* sector, boolean crunch);
@@ -245,8 +251,8 @@ P_RadiusAttack
 // P_SETUP
 //
 extern byte*            rejectmatrix;   // for fast sight rejection
-extern short*           blockmaplump;   // offsets in blockmap are from here
-extern short*           blockmap;
+extern int*             blockmap;       // where each block starts in blocklines
+extern int*             blocklines;     // line numbers, block after block
 extern int              bmapwidth;
 extern int              bmapheight;     // in mapblocks
 extern fixed_t          bmaporgx;
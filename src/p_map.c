@@ -385,6 +385,9 @@ P_CheckPosition
     int                 yh;
     int                 bx;
     int                 by;
+    int                 i;
+    int                 count;
+    line_t**            ld;
     subsector_t*        newsubsec;
 
     tmthing = thing;
@@ -435,10 +438,11 @@ P_CheckPosition
     yl = (tmbbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
     yh = (tmbbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
 
-    for (bx=xl ; bx<=xh ; bx++)
-        for (by=yl ; by<=yh ; by++)
-            if (!P_BlockLinesIterator (bx,by,PIT_CheckLine))
-                return false;
+    ld = P_BlockLinesInBox (xl,yl,xh,yh,&count);
+
+    for (i=0 ; i<count ; i++)
+        if (!PIT_CheckLine (ld[i]))
+            return false;
 
     return true;
 }
@@ -35,6 +35,7 @@ rcsid[] = "$Id: p_maputl.c,v 1.5 1997/02/03 22:45:11 b1 Exp $";
 #include "m_bbox.h"
 
 #include "doomdef.h"
+#include "z_zone.h"
 #include "p_local.h"
 
 
@@ -476,7 +477,8 @@ P_BlockLinesIterator
   boolean(*func)(line_t*) )
 {
     int                 offset;
-    short*              list;
+    int*                list;
+    int*                end;
     line_t*             ld;
 
     if (x<0
@@ -489,17 +491,15 @@ P_BlockLinesIterator
 
     offset = y*bmapwidth+x;
 
-    offset = *(blockmap+offset);
-
-    for ( list = blockmaplump+offset ; *list != -1 ; list++)
+    end = blocklines + blockmap[offset+1];
+    for ( list = blocklines + blockmap[offset] ; list < end ; list++)
     {
-        ld = &lines[*list];
-
-        if (ld->validcount == validcount)
+        if (linevalidcount[*list] == validcount)
             continue;   // line has already been checked
 
-        ld->validcount = validcount;
+        linevalidcount[*list] = validcount;
 
+        ld = &lines[*list];
         if ( !func(ld) )
             return false;
     }
@@ -507,6 +507,72 @@ P_BlockLinesIterator
 }
 
 
+//
+// P_BlockLinesInBox
+// Collects the lines of blocks xl..xh, yl..yh in the order
+// P_BlockLinesIterator would visit them (bx outer, by inner),
+// each once, so a caller can run its checks over a flat array.
+// Increment validcount first, as for the iterator.
+// The array is reused by the next call.
+//
+static line_t**         boxlines;
+static int              maxboxlines;
+
+line_t**
+P_BlockLinesInBox
+( int                   xl,
+  int                   yl,
+  int                   xh,
+  int                   yh,
+  int*                  count )
+{
+    int                 bx;
+    int                 by;
+    int                 num;
+    int*                list;
+    int*                end;
+
+    if (xl < 0)
+        xl = 0;
+    if (yl < 0)
+        yl = 0;
+    if (xh >= bmapwidth)
+        xh = bmapwidth-1;
+    if (yh >= bmapheight)
+        yh = bmapheight-1;
+
+    num = 0;
+    for (bx=xl ; bx<=xh ; bx++)
+    {
+        for (by=yl ; by<=yh ; by++)
+        {
+            list = blocklines + blockmap[by*bmapwidth+bx];
+            end = blocklines + blockmap[by*bmapwidth+bx+1];
+
+            for ( ; list < end ; list++)
+            {
+                if (linevalidcount[*list] == validcount)
+                    continue;
+
+                linevalidcount[*list] = validcount;
+
+                if (num == maxboxlines)
+                {
+                    boxlines = Z_GrowArray (boxlines, num,
+                                            maxboxlines ? maxboxlines*2 : 64,
+                                            sizeof(*boxlines));
+                    maxboxlines = maxboxlines ? maxboxlines*2 : 64;
+                }
+                boxlines[num++] = &lines[*list];
+            }
+        }
+    }
+
+    *count = num;
+    return boxlines;
+}
+
+
 //
 // P_BlockThingsIterator
 //
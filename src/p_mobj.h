@@ -205,6 +205,10 @@ typedef enum
 
 
 // Map Object definition.
+// The fields P_MobjThinker, P_XYMovement and P_ZMovement touch
+//  every tic come first and fill the first 64 bytes on a 32 bit
+//  target; mobjs come from line aligned zone pool slots, so that
+//  is one cache line. state is only read when tics runs out.
 typedef struct mobj_s
 {
     // List: thinker links.
@@ -215,21 +219,10 @@ typedef struct mobj_s
     fixed_t             y;
     fixed_t             z;
 
-    // More list: links in sector (if needed)
-    struct mobj_s*      snext;
-    struct mobj_s*      sprev;
-
-    //More drawing info: to determine current sprite.
-    angle_t             angle;  // orientation
-    spritenum_t         sprite; // used to find patch_t and flip value
-    int                 frame;  // might be ORed with FF_FULLBRIGHT
-
-    // Interaction info, by BLOCKMAP.
-    // Links in blocks (if needed).
-    struct mobj_s*      bnext;
-    struct mobj_s*      bprev;
-
-    struct subsector_s* subsector;
+    // Momentums, used to update position.
+    fixed_t             momx;
+    fixed_t             momy;
+    fixed_t             momz;
 
     // The closest interval over all contacted Sectors.
     fixed_t             floorz;
@@ -239,22 +232,39 @@ typedef struct mobj_s
     fixed_t             radius;
     fixed_t             height;
 
-    // Momentums, used to update position.
-    fixed_t             momx;
-    fixed_t             momy;
-    fixed_t             momz;
+    int                 flags;
+    int                 tics;   // state tic counter
 
-    // If == validcount, already checked.
-    int                 validcount;
+    // Additional info record for player avatars only.
+    // Only valid if type == MT_PLAYER
+    struct player_s*    player;
+
+    state_t*            state;
+
+    struct subsector_s* subsector;
 
     mobjtype_t          type;
     mobjinfo_t*         info;   // &mobjinfo[mobj->type]
 
-    int                 tics;   // state tic counter
-    state_t*            state;
-    int                 flags;
     int                 health;
 
+    //More drawing info: to determine current sprite.
+    angle_t             angle;  // orientation
+    spritenum_t         sprite; // used to find patch_t and flip value
+    int                 frame;  // might be ORed with FF_FULLBRIGHT
+
+    // If == validcount, already checked.
+    int                 validcount;
+
+    // More list: links in sector (if needed)
+    struct mobj_s*      snext;
+    struct mobj_s*      sprev;
+
+    // Interaction info, by BLOCKMAP.
+    // Links in blocks (if needed).
+    struct mobj_s*      bnext;
+    struct mobj_s*      bprev;
+
     // Movement direction, movement generation (zig-zagging).
     int                 movedir;        // 0-7
     int                 movecount;      // when 0, select a new dir
@@ -271,10 +281,6 @@ typedef struct mobj_s
     // no matter what (even if shot)
     int                 threshold;
 
-    // Additional info record for player avatars only.
-    // Only valid if type == MT_PLAYER
-    struct player_s*    player;
-
     // Player number last looked for.
     int                 lastlook;
 
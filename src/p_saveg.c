@@ -26,50 +26,328 @@ static const char __attribute__((unused))
 rcsid[] = "$Id: p_tick.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 
 
+#include <stdio.h>
+
 #include "i_system.h"
 #include "z_zone.h"
 #include "p_local.h"
+#include "p_saveg.h"
 
 // State.
 #include "doomstat.h"
 #include "r_state.h"
 
-byte*           save_p;
 
+//
+// SAVEGAME STREAM
+// Savegames are written and read through one small buffer,
+//  so their size is only bounded by the disk.
+// Numbers are stored little endian.
+//
+#define SAVECHUNK       4096
+
+static byte             savechunk[SAVECHUNK];
+static FILE*            savefile;
+static int              savepos;
+static int              saveend;
+static boolean          savewriting;
+static boolean          saveerror;
+
+
+static void P_FlushSave (void)
+{
+    if (savepos && fwrite (savechunk, 1, savepos, savefile) != savepos)
+        saveerror = true;
+    savepos = 0;
+}
+
+
+//
+// P_OpenSaveGame
+// Returns false if the file can't be opened.
+//
+boolean P_OpenSaveGame (char* name, boolean writing)
+{
+    if (writing)
+        savefile = fopen (name, "wb");
+    else
+        savefile = fopen (name, "rb");
 
-// Pads save_p to a 4-byte boundary
-//  so that the load/save works on SGI&Gecko.
-#define PADSAVEP()      save_p += (4 - ((int) save_p & 3)) & 3
+    savepos = saveend = 0;
+    savewriting = writing;
+    saveerror = false;
+
+    return savefile != NULL;
+}
+
+
+//
+// P_CloseSaveGame
+// Returns false if anything failed to be written.
+//
+boolean P_CloseSaveGame (void)
+{
+    if (savewriting)
+        P_FlushSave ();
+
+    if (fclose (savefile))
+        saveerror = true;
+    savefile = NULL;
+
+    return !saveerror;
+}
+
+
+void P_WriteBytes (void* data, int length)
+{
+    byte*       src = data;
+    int         count;
+
+    while (length)
+    {
+        count = SAVECHUNK - savepos;
+        if (count > length)
+            count = length;
+
+        memcpy (savechunk+savepos, src, count);
+        savepos += count;
+        src += count;
+        length -= count;
+
+        if (savepos == SAVECHUNK)
+            P_FlushSave ();
+    }
+}
+
+
+void P_ReadBytes (void* data, int length)
+{
+    byte*       dest = data;
+    int         count;
+
+    while (length)
+    {
+        if (savepos == saveend)
+        {
+            saveend = fread (savechunk, 1, SAVECHUNK, savefile);
+            savepos = 0;
+
+            if (saveend <= 0)
+                I_Error ("Bad savegame: truncated");
+        }
+
+        count = saveend - savepos;
+        if (count > length)
+            count = length;
+
+        memcpy (dest, savechunk+savepos, count);
+        savepos += count;
+        dest += count;
+        length -= count;
+    }
+}
+
+
+void P_WriteByte (int value)
+{
+    byte        b = value;
+
+    P_WriteBytes (&b, 1);
+}
+
+void P_WriteShort (int value)
+{
+    byte        b[2];
+
+    b[0] = value;
+    b[1] = value >> 8;
+    P_WriteBytes (b, 2);
+}
+
+void P_WriteLong (int value)
+{
+    byte        b[4];
+
+    b[0] = value;
+    b[1] = value >> 8;
+    b[2] = value >> 16;
+    b[3] = value >> 24;
+    P_WriteBytes (b, 4);
+}
+
+int P_ReadByte (void)
+{
+    byte        b;
+
+    P_ReadBytes (&b, 1);
+    return b;
+}
+
+int P_ReadShort (void)
+{
+    byte        b[2];
+
+    P_ReadBytes (b, 2);
+    return (short)(b[0] | (b[1] << 8));
+}
+
+int P_ReadLong (void)
+{
+    byte        b[4];
+
+    P_ReadBytes (b, 4);
+    return b[0] | (b[1] << 8) | (b[2] << 16) | ((unsigned)b[3] << 24);
+}
+
+
+
+//
+// MOBJ FIXUPS
+// Pointers to mobjs are saved as 1 based numbers in save order,
+//  0 for none; a hash finds the number of a mobj when saving,
+//  a table the mobj of a number when loading.
+//
+static mobj_t**         mobjhash;
+static int*             mobjhashnum;
+static int              mobjhashsize;
+
+static mobj_t**         mobjtable;
+static int              nummobjs;
+
+
+static void P_NumberMobjs (void)
+{
+    thinker_t*  th;
+    mobj_t*     mo;
+    int         count;
+    int         h;
+
+    count = 0;
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+        if (th->function.acp1 == (actionf_p1)P_MobjThinker)
+            count++;
+
+    for (mobjhashsize = 64 ; mobjhashsize < count*2 ; mobjhashsize <<= 1)
+        ;
+
+    mobjhash = Z_Malloc (mobjhashsize*sizeof(*mobjhash), PU_STATIC, NULL);
+    mobjhashnum = Z_Malloc (mobjhashsize*sizeof(*mobjhashnum), PU_STATIC, NULL);
+    memset (mobjhash, 0, mobjhashsize*sizeof(*mobjhash));
+
+    nummobjs = 0;
+    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    {
+        if (th->function.acp1 != (actionf_p1)P_MobjThinker)
+            continue;
+
+        mo = (mobj_t *)th;
+        h = ((size_t)mo >> 4) & (mobjhashsize-1);
+        while (mobjhash[h])
+            h = (h+1) & (mobjhashsize-1);
+
+        mobjhash[h] = mo;
+        mobjhashnum[h] = ++nummobjs;
+    }
+}
+
+
+// Removed mobjs are not saved, pointers to them become 0.
+static int P_MobjNum (mobj_t* mo)
+{
+    int         h;
+
+    if (!mo)
+        return 0;
+
+    h = ((size_t)mo >> 4) & (mobjhashsize-1);
+    while (mobjhash[h])
+    {
+        if (mobjhash[h] == mo)
+            return mobjhashnum[h];
+        h = (h+1) & (mobjhashsize-1);
+    }
+    return 0;
+}
+
+
+static mobj_t* P_NumMobj (int num)
+{
+    if (num <= 0 || num > nummobjs)
+        return NULL;
+    return mobjtable[num];
+}
 
 
 
 //
 // P_ArchivePlayers
+// Field by field, mo and message are not saved.
 //
-void P_ArchivePlayers (void)
+static void P_ArchivePlayers (void)
 {
+    player_t*   p;
+    pspdef_t*   psp;
     int         i;
     int         j;
-    player_t*   dest;
 
     for (i=0 ; i<MAXPLAYERS ; i++)
     {
         if (!playeringame[i])
             continue;
 
-        PADSAVEP();
-
-        dest = (player_t *)save_p;
-        memcpy (dest,&players[i],sizeof(player_t));
-        save_p += sizeof(player_t);
-        for (j=0 ; j<NUMPSPRITES ; j++)
+        p = &players[i];
+
+        P_WriteLong (p->playerstate);
+        P_WriteByte (p->cmd.forwardmove);
+        P_WriteByte (p->cmd.sidemove);
+        P_WriteShort (p->cmd.angleturn);
+        P_WriteShort (p->cmd.consistancy);
+        P_WriteByte (p->cmd.chatchar);
+        P_WriteByte (p->cmd.buttons);
+        P_WriteLong (p->viewz);
+        P_WriteLong (p->viewheight);
+        P_WriteLong (p->deltaviewheight);
+        P_WriteLong (p->bob);
+        P_WriteLong (p->health);
+        P_WriteLong (p->armorpoints);
+        P_WriteLong (p->armortype);
+        for (j=0 ; j<NUMPOWERS ; j++)
+            P_WriteLong (p->powers[j]);
+        for (j=0 ; j<NUMCARDS ; j++)
+            P_WriteByte (p->cards[j]);
+        P_WriteByte (p->backpack);
+        for (j=0 ; j<MAXPLAYERS ; j++)
+            P_WriteLong (p->frags[j]);
+        P_WriteLong (p->readyweapon);
+        P_WriteLong (p->pendingweapon);
+        for (j=0 ; j<NUMWEAPONS ; j++)
+            P_WriteByte (p->weaponowned[j]);
+        for (j=0 ; j<NUMAMMO ; j++)
         {
-            if (dest->psprites[j].state)
-            {
-                dest->psprites[j].state
-                    = (state_t *)(dest->psprites[j].state-states);
-            }
+            P_WriteLong (p->ammo[j]);
+            P_WriteLong (p->maxammo[j]);
         }
+        P_WriteLong (p->attackdown);
+        P_WriteLong (p->usedown);
+        P_WriteLong (p->cheats);
+        P_WriteLong (p->refire);
+        P_WriteLong (p->killcount);
+        P_WriteLong (p->itemcount);
+        P_WriteLong (p->secretcount);
+        P_WriteLong (p->damagecount);
+        P_WriteLong (p->bonuscount);
+        P_WriteLong (P_MobjNum (p->attacker));
+        P_WriteLong (p->extralight);
+        P_WriteLong (p->fixedcolormap);
+        P_WriteLong (p->colormap);
+        for (j=0, psp=p->psprites ; j<NUMPSPRITES ; j++, psp++)
+        {
+            P_WriteLong (psp->state ? psp->state-states+1 : 0);
+            P_WriteLong (psp->tics);
+            P_WriteLong (psp->sx);
+            P_WriteLong (psp->sy);
+        }
+        P_WriteByte (p->didsecret);
     }
 }
 
@@ -77,9 +355,13 @@ void P_ArchivePlayers (void)
 
 //
 // P_UnArchivePlayers
+// attacker is fixed up once the mobjs are in.
 //
-void P_UnArchivePlayers (void)
+static void P_UnArchivePlayers (void)
 {
+    player_t*   p;
+    pspdef_t*   psp;
+    int         state;
     int         i;
     int         j;
 
@@ -88,77 +370,227 @@ void P_UnArchivePlayers (void)
         if (!playeringame[i])
             continue;
 
-        PADSAVEP();
-
-        memcpy (&players[i],save_p, sizeof(player_t));
-        save_p += sizeof(player_t);
+        p = &players[i];
 
         // will be set when unarc thinker
-        players[i].mo = NULL;
-        players[i].message = NULL;
-        players[i].attacker = NULL;
-
-        for (j=0 ; j<NUMPSPRITES ; j++)
+        p->mo = NULL;
+        p->message = NULL;
+
+        p->playerstate = P_ReadLong ();
+        p->cmd.forwardmove = (signed char)P_ReadByte ();
+        p->cmd.sidemove = (signed char)P_ReadByte ();
+        p->cmd.angleturn = P_ReadShort ();
+        p->cmd.consistancy = P_ReadShort ();
+        p->cmd.chatchar = P_ReadByte ();
+        p->cmd.buttons = P_ReadByte ();
+        p->viewz = P_ReadLong ();
+        p->viewheight = P_ReadLong ();
+        p->deltaviewheight = P_ReadLong ();
+        p->bob = P_ReadLong ();
+        p->health = P_ReadLong ();
+        p->armorpoints = P_ReadLong ();
+        p->armortype = P_ReadLong ();
+        for (j=0 ; j<NUMPOWERS ; j++)
+            p->powers[j] = P_ReadLong ();
+        for (j=0 ; j<NUMCARDS ; j++)
+            p->cards[j] = P_ReadByte ();
+        p->backpack = P_ReadByte ();
+        for (j=0 ; j<MAXPLAYERS ; j++)
+            p->frags[j] = P_ReadLong ();
+        p->readyweapon = P_ReadLong ();
+        p->pendingweapon = P_ReadLong ();
+        for (j=0 ; j<NUMWEAPONS ; j++)
+            p->weaponowned[j] = P_ReadByte ();
+        for (j=0 ; j<NUMAMMO ; j++)
         {
-            if (players[i]. psprites[j].state)
-            {
-                players[i]. psprites[j].state
-                    = &states[ (int)players[i].psprites[j].state ];
-            }
+            p->ammo[j] = P_ReadLong ();
+            p->maxammo[j] = P_ReadLong ();
+        }
+        p->attackdown = P_ReadLong ();
+        p->usedown = P_ReadLong ();
+        p->cheats = P_ReadLong ();
+        p->refire = P_ReadLong ();
+        p->killcount = P_ReadLong ();
+        p->itemcount = P_ReadLong ();
+        p->secretcount = P_ReadLong ();
+        p->damagecount = P_ReadLong ();
+        p->bonuscount = P_ReadLong ();
+        p->attacker = (mobj_t *)(size_t)P_ReadLong ();
+        p->extralight = P_ReadLong ();
+        p->fixedcolormap = P_ReadLong ();
+        p->colormap = P_ReadLong ();
+        for (j=0, psp=p->psprites ; j<NUMPSPRITES ; j++, psp++)
+        {
+            state = P_ReadLong ();
+            if (state < 0 || state > NUMSTATES)
+                I_Error ("Bad savegame: state %i", state);
+
+            psp->state = state ? &states[state-1] : NULL;
+            psp->tics = P_ReadLong ();
+            psp->sx = P_ReadLong ();
+            psp->sy = P_ReadLong ();
         }
+        p->didsecret = P_ReadByte ();
     }
 }
 
 
+
 //
-// P_ArchiveWorld
+// WORLD
+// Only the sectors and lines that differ from the state the
+//  level had right after P_SetupLevel are saved, as their
+//  number followed by the record, ending with 0xffff.
+// Loading sets the level up first, so the rest is already right.
 //
-void P_ArchiveWorld (void)
+#define SECTORRECORD    7
+#define LINERECORD      13      // with both sides
+
+static int*             sectorbase;
+static short*           linebase;
+
+
+static void P_SectorRecord (sector_t* sec, int* rec)
 {
-    int                 i;
-    int                 j;
-    sector_t*           sec;
-    line_t*             li;
-    side_t*             si;
-    short*              put;
+    rec[0] = sec->floorheight;
+    rec[1] = sec->ceilingheight;
+    rec[2] = sec->floorpic;
+    rec[3] = sec->ceilingpic;
+    rec[4] = sec->lightlevel;
+    rec[5] = sec->special;
+    rec[6] = sec->tag;
+}
 
-    put = (short *)save_p;
 
-    // do sectors
-    for (i=0, sec = sectors ; i<numsectors ; i++,sec++)
+static void P_SetSectorRecord (sector_t* sec, int* rec)
+{
+    sec->floorheight = rec[0];
+    sec->ceilingheight = rec[1];
+    sec->floorpic = rec[2];
+    sec->ceilingpic = rec[3];
+    sec->lightlevel = rec[4];
+    sec->special = rec[5];
+    sec->tag = rec[6];
+}
+
+
+// Returns the record length, which only depends on the sides.
+static int P_LineRecord (line_t* li, short* rec)
+{
+    side_t*     si;
+    int         n;
+    int         j;
+
+    n = 0;
+    rec[n++] = li->flags;
+    rec[n++] = li->special;
+    rec[n++] = li->tag;
+    for (j=0 ; j<2 ; j++)
     {
-        *put++ = sec->floorheight >> FRACBITS;
-        *put++ = sec->ceilingheight >> FRACBITS;
-        *put++ = sec->floorpic;
-        *put++ = sec->ceilingpic;
-        *put++ = sec->lightlevel;
-        *put++ = sec->special;          // needed?
-        *put++ = sec->tag;              // needed?
+        if (li->sidenum[j] == -1)
+            continue;
+
+        si = &sides[li->sidenum[j]];
+
+        rec[n++] = si->textureoffset >> FRACBITS;
+        rec[n++] = si->rowoffset >> FRACBITS;
+        rec[n++] = si->toptexture;
+        rec[n++] = si->bottomtexture;
+        rec[n++] = si->midtexture;
     }
+    return n;
+}
 
 
-    // do lines
-    for (i=0, li = lines ; i<numlines ; i++,li++)
+static void P_SetLineRecord (line_t* li, short* rec)
+{
+    side_t*     si;
+    int         j;
+
+    li->flags = *rec++;
+    li->special = *rec++;
+    li->tag = *rec++;
+    for (j=0 ; j<2 ; j++)
     {
-        *put++ = li->flags;
-        *put++ = li->special;
-        *put++ = li->tag;
-        for (j=0 ; j<2 ; j++)
-        {
-            if (li->sidenum[j] == -1)
-                continue;
+        if (li->sidenum[j] == -1)
+            continue;
 
-            si = &sides[li->sidenum[j]];
+        si = &sides[li->sidenum[j]];
 
-            *put++ = si->textureoffset >> FRACBITS;
-            *put++ = si->rowoffset >> FRACBITS;
-            *put++ = si->toptexture;
-            *put++ = si->bottomtexture;
-            *put++ = si->midtexture;
-        }
+        si->textureoffset = *rec++ << FRACBITS;
+        si->rowoffset = *rec++ << FRACBITS;
+        si->toptexture = *rec++;
+        si->bottomtexture = *rec++;
+        si->midtexture = *rec++;
     }
+}
+
+
+//
+// P_SnapshotWorld
+// Keeps the initial state of the level, the base for
+// the world deltas. Called at the end of P_SetupLevel.
+//
+void P_SnapshotWorld (void)
+{
+    short       rec[LINERECORD];
+    int         size;
+    int         i;
+
+    sectorbase = Z_Malloc (numsectors*SECTORRECORD*sizeof(int), PU_LEVEL, NULL);
+    for (i=0 ; i<numsectors ; i++)
+        P_SectorRecord (&sectors[i], sectorbase + i*SECTORRECORD);
+
+    size = 0;
+    for (i=0 ; i<numlines ; i++)
+        size += P_LineRecord (&lines[i], rec);
 
-    save_p = (byte *)put;
+    linebase = Z_Malloc (size*sizeof(short), PU_LEVEL, NULL);
+    size = 0;
+    for (i=0 ; i<numlines ; i++)
+        size += P_LineRecord (&lines[i], linebase+size);
+}
+
+
+//
+// P_ArchiveWorld
+//
+static void P_ArchiveWorld (void)
+{
+    int         srec[SECTORRECORD];
+    short       lrec[LINERECORD];
+    short*      base;
+    int         i;
+    int         j;
+    int         n;
+
+    // do sectors
+    for (i=0 ; i<numsectors ; i++)
+    {
+        P_SectorRecord (&sectors[i], srec);
+        if (!memcmp (srec, sectorbase + i*SECTORRECORD, sizeof(srec)))
+            continue;
+
+        P_WriteShort (i);
+        for (j=0 ; j<SECTORRECORD ; j++)
+            P_WriteLong (srec[j]);
+    }
+    P_WriteShort (-1);
+
+    // do lines
+    base = linebase;
+    for (i=0 ; i<numlines ; i++)
+    {
+        n = P_LineRecord (&lines[i], lrec);
+        base += n;
+        if (!memcmp (lrec, base-n, n*sizeof(short)))
+            continue;
+
+        P_WriteShort (i);
+        for (j=0 ; j<n ; j++)
+            P_WriteShort (lrec[j]);
+    }
+    P_WriteShort (-1);
 }
 
 
@@ -166,50 +598,44 @@ void P_ArchiveWorld (void)
 //
 // P_UnArchiveWorld
 //
-void P_UnArchiveWorld (void)
+static void P_UnArchiveWorld (void)
 {
-    int                 i;
-    int                 j;
-    sector_t*           sec;
-    line_t*             li;
-    side_t*             si;
-    short*              get;
+    int         srec[SECTORRECORD];
+    short       lrec[LINERECORD];
+    int         i;
+    int         j;
+    int         n;
 
-    get = (short *)save_p;
+    P_ClearSightCache ();
+
+    for (i=0 ; i<numsectors ; i++)
+    {
+        sectors[i].specialdata = 0;
+        sectors[i].soundtarget = 0;
+    }
 
     // do sectors
-    for (i=0, sec = sectors ; i<numsectors ; i++,sec++)
+    while ((i = (unsigned short)P_ReadShort ()) != 0xffff)
     {
-        sec->floorheight = *get++ << FRACBITS;
-        sec->ceilingheight = *get++ << FRACBITS;
-        sec->floorpic = *get++;
-        sec->ceilingpic = *get++;
-        sec->lightlevel = *get++;
-        sec->special = *get++;          // needed?
-        sec->tag = *get++;              // needed?
-        sec->specialdata = 0;
-        sec->soundtarget = 0;
+        if (i >= numsectors)
+            I_Error ("Bad savegame: sector %i", i);
+
+        for (j=0 ; j<SECTORRECORD ; j++)
+            srec[j] = P_ReadLong ();
+        P_SetSectorRecord (&sectors[i], srec);
     }
 
     // do lines
-    for (i=0, li = lines ; i<numlines ; i++,li++)
+    while ((i = (unsigned short)P_ReadShort ()) != 0xffff)
     {
-        li->flags = *get++;
-        li->special = *get++;
-        li->tag = *get++;
-        for (j=0 ; j<2 ; j++)
-        {
-            if (li->sidenum[j] == -1)
-                continue;
-            si = &sides[li->sidenum[j]];
-            si->textureoffset = *get++ << FRACBITS;
-            si->rowoffset = *get++ << FRACBITS;
-            si->toptexture = *get++;
-            si->bottomtexture = *get++;
-            si->midtexture = *get++;
-        }
+        if (i >= numlines)
+            I_Error ("Bad savegame: line %i", i);
+
+        n = P_LineRecord (&lines[i], lrec);
+        for (j=0 ; j<n ; j++)
+            lrec[j] = P_ReadShort ();
+        P_SetLineRecord (&lines[i], lrec);
     }
-    save_p = (byte *)get;
 }
 
 
@@ -230,26 +656,52 @@ typedef enum
 
 //
 // P_ArchiveThinkers
+// The mobj count comes first, so the loader can size its table.
 //
-void P_ArchiveThinkers (void)
+static void P_ArchiveThinkers (void)
 {
     thinker_t*          th;
     mobj_t*             mobj;
 
+    P_WriteLong (nummobjs);
+
     // save off the current thinkers
     for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
     {
         if (th->function.acp1 == (actionf_p1)P_MobjThinker)
         {
-            *save_p++ = tc_mobj;
-            PADSAVEP();
-            mobj = (mobj_t *)save_p;
-            memcpy (mobj, th, sizeof(*mobj));
-            save_p += sizeof(*mobj);
-            mobj->state = (state_t *)(mobj->state - states);
-
-            if (mobj->player)
-                mobj->player = (player_t *)((mobj->player-players) + 1);
+            mobj = (mobj_t *)th;
+
+            P_WriteByte (tc_mobj);
+            P_WriteLong (mobj->x);
+            P_WriteLong (mobj->y);
+            P_WriteLong (mobj->z);
+            P_WriteLong (mobj->angle);
+            P_WriteLong (mobj->sprite);
+            P_WriteLong (mobj->frame);
+            P_WriteLong (mobj->radius);
+            P_WriteLong (mobj->height);
+            P_WriteLong (mobj->momx);
+            P_WriteLong (mobj->momy);
+            P_WriteLong (mobj->momz);
+            P_WriteLong (mobj->type);
+            P_WriteLong (mobj->tics);
+            P_WriteLong (mobj->state - states);
+            P_WriteLong (mobj->flags);
+            P_WriteLong (mobj->health);
+            P_WriteLong (mobj->movedir);
+            P_WriteLong (mobj->movecount);
+            P_WriteLong (P_MobjNum (mobj->target));
+            P_WriteLong (P_MobjNum (mobj->tracer));
+            P_WriteLong (mobj->reactiontime);
+            P_WriteLong (mobj->threshold);
+            P_WriteLong (mobj->player ? mobj->player-players+1 : 0);
+            P_WriteLong (mobj->lastlook);
+            P_WriteShort (mobj->spawnpoint.x);
+            P_WriteShort (mobj->spawnpoint.y);
+            P_WriteShort (mobj->spawnpoint.angle);
+            P_WriteShort (mobj->spawnpoint.type);
+            P_WriteShort (mobj->spawnpoint.options);
             continue;
         }
 
@@ -257,7 +709,7 @@ void P_ArchiveThinkers (void)
     }
 
     // add a terminating marker
-    *save_p++ = tc_end;
+    P_WriteByte (tc_end);
 }
 
 
@@ -265,12 +717,15 @@ void P_ArchiveThinkers (void)
 //
 // P_UnArchiveThinkers
 //
-void P_UnArchiveThinkers (void)
+static void P_UnArchiveThinkers (void)
 {
     byte                tclass;
     thinker_t*          currentthinker;
     thinker_t*          next;
     mobj_t*             mobj;
+    int                 player;
+    int                 state;
+    int                 i;
 
     // remove all the current thinkers
     currentthinker = thinkercap.next;
@@ -285,27 +740,93 @@ void P_UnArchiveThinkers (void)
 
         currentthinker = next;
     }
+
+    currentthinker = lightcap.next;
+    while (currentthinker != &lightcap)
+    {
+        next = currentthinker->next;
+        Z_Free (currentthinker);
+        currentthinker = next;
+    }
     P_InitThinkers ();
 
+    nummobjs = P_ReadLong ();
+    if (nummobjs < 0)
+        I_Error ("Bad savegame: %i mobjs", nummobjs);
+
+    mobjtable = Z_Malloc ((nummobjs+1)*sizeof(*mobjtable), PU_STATIC, NULL);
+    i = 0;
+
     // read in saved thinkers
     while (1)
     {
-        tclass = *save_p++;
+        tclass = P_ReadByte ();
         switch (tclass)
         {
           case tc_end:
+            if (i != nummobjs)
+                I_Error ("Bad savegame: %i of %i mobjs", i, nummobjs);
+
+            // now every mobj has a number
+            for (i=1 ; i<=nummobjs ; i++)
+            {
+                mobj = mobjtable[i];
+                mobj->target = P_NumMobj ((size_t)mobj->target);
+                mobj->tracer = P_NumMobj ((size_t)mobj->tracer);
+            }
             return;     // end of list
 
           case tc_mobj:
-            PADSAVEP();
+            if (i == nummobjs)
+                I_Error ("Bad savegame: too many mobjs");
+
             mobj = Z_Malloc (sizeof(*mobj), PU_LEVEL, NULL);
-            memcpy (mobj, save_p, sizeof(*mobj));
-            save_p += sizeof(*mobj);
-            mobj->state = &states[(int)mobj->state];
-            mobj->target = NULL;
-            if (mobj->player)
+            memset (mobj, 0, sizeof(*mobj));
+            mobjtable[++i] = mobj;
+
+            mobj->x = P_ReadLong ();
+            mobj->y = P_ReadLong ();
+            mobj->z = P_ReadLong ();
+            mobj->angle = P_ReadLong ();
+            mobj->sprite = P_ReadLong ();
+            mobj->frame = P_ReadLong ();
+            mobj->radius = P_ReadLong ();
+            mobj->height = P_ReadLong ();
+            mobj->momx = P_ReadLong ();
+            mobj->momy = P_ReadLong ();
+            mobj->momz = P_ReadLong ();
+            mobj->type = P_ReadLong ();
+            if ((unsigned)mobj->type >= NUMMOBJTYPES)
+                I_Error ("Bad savegame: mobj type %i", mobj->type);
+
+            mobj->tics = P_ReadLong ();
+            state = P_ReadLong ();
+            if (state < 0 || state >= NUMSTATES)
+                I_Error ("Bad savegame: state %i", state);
+
+            mobj->state = &states[state];
+            mobj->flags = P_ReadLong ();
+            mobj->health = P_ReadLong ();
+            mobj->movedir = P_ReadLong ();
+            mobj->movecount = P_ReadLong ();
+            mobj->target = (mobj_t *)(size_t)P_ReadLong ();
+            mobj->tracer = (mobj_t *)(size_t)P_ReadLong ();
+            mobj->reactiontime = P_ReadLong ();
+            mobj->threshold = P_ReadLong ();
+            player = P_ReadLong ();
+            if (player < 0 || player > MAXPLAYERS)
+                I_Error ("Bad savegame: player %i", player);
+
+            mobj->lastlook = P_ReadLong ();
+            mobj->spawnpoint.x = P_ReadShort ();
+            mobj->spawnpoint.y = P_ReadShort ();
+            mobj->spawnpoint.angle = P_ReadShort ();
+            mobj->spawnpoint.type = P_ReadShort ();
+            mobj->spawnpoint.options = P_ReadShort ();
+
+            if (player)
             {
-                mobj->player = &players[(int)mobj->player-1];
+                mobj->player = &players[player-1];
                 mobj->player->mo = mobj;
             }
             P_SetThingPosition (mobj);
@@ -354,119 +875,165 @@ enum
 // T_Glow, (glow_t: sector_t *),
 // T_PlatRaise, (plat_t: sector_t *), - active list
 //
-void P_ArchiveSpecials (void)
+// Each is saved as its class, its sector number and its fields.
+//
+static void
+P_WriteSpecial
+( int           tclass,
+  sector_t*     sector )
 {
+    P_WriteByte (tclass);
+    P_WriteLong (sector - sectors);
+}
+
+
+static sector_t* P_ReadSpecial (void)
+{
+    int         sec;
+
+    sec = P_ReadLong ();
+    if (sec < 0 || sec >= numsectors)
+        I_Error ("Bad savegame: sector %i", sec);
+
+    return &sectors[sec];
+}
+
+
+// In stasis or moving.
+static void P_WriteCeiling (ceiling_t* ceiling)
+{
+    P_WriteSpecial (tc_ceiling, ceiling->sector);
+    P_WriteByte (ceiling->thinker.function.acv != (actionf_v)NULL);
+    P_WriteLong (ceiling->type);
+    P_WriteLong (ceiling->bottomheight);
+    P_WriteLong (ceiling->topheight);
+    P_WriteLong (ceiling->speed);
+    P_WriteByte (ceiling->crush);
+    P_WriteLong (ceiling->direction);
+    P_WriteLong (ceiling->tag);
+    P_WriteLong (ceiling->olddirection);
+}
+
+
+static void P_ArchiveSpecials (void)
+{
+    thinker_t*          cap;
     thinker_t*          th;
-    ceiling_t*          ceiling;
     vldoor_t*           door;
     floormove_t*        floor;
     plat_t*             plat;
     lightflash_t*       flash;
     strobe_t*           strobe;
     glow_t*             glow;
+    int                 list;
     int                 i;
 
-    // save off the current thinkers
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    // save off the current thinkers, then the lights
+    for (list=0 ; list<2 ; list++)
     {
-        if (th->function.acv == (actionf_v)NULL)
-        {
-            for (i = 0; i < MAXCEILINGS;i++)
-                if (activeceilings[i] == (ceiling_t *)th)
-                    break;
+        cap = list ? &lightcap : &thinkercap;
 
-            if (i<MAXCEILINGS)
+        for (th = cap->next ; th != cap ; th=th->next)
+        {
+            if (th->function.acv == (actionf_v)NULL)
             {
-                *save_p++ = tc_ceiling;
-                PADSAVEP();
-                ceiling = (ceiling_t *)save_p;
-                memcpy (ceiling, th, sizeof(*ceiling));
-                save_p += sizeof(*ceiling);
-                ceiling->sector = (sector_t *)(ceiling->sector - sectors);
+                for (i = 0; i < MAXCEILINGS;i++)
+                    if (activeceilings[i] == (ceiling_t *)th)
+                        break;
+
+                if (i<MAXCEILINGS)
+                    P_WriteCeiling ((ceiling_t *)th);
+                continue;
             }
-            continue;
-        }
 
-        if (th->function.acp1 == (actionf_p1)T_MoveCeiling)
-        {
-            *save_p++ = tc_ceiling;
-            PADSAVEP();
-            ceiling = (ceiling_t *)save_p;
-            memcpy (ceiling, th, sizeof(*ceiling));
-            save_p += sizeof(*ceiling);
-            ceiling->sector = (sector_t *)(ceiling->sector - sectors);
-            continue;
-        }
+            if (th->function.acp1 == (actionf_p1)T_MoveCeiling)
+            {
+                P_WriteCeiling ((ceiling_t *)th);
+                continue;
+            }
 
-        if (th->function.acp1 == (actionf_p1)T_VerticalDoor)
-        {
-            *save_p++ = tc_door;
-            PADSAVEP();
-            door = (vldoor_t *)save_p;
-            memcpy (door, th, sizeof(*door));
-            save_p += sizeof(*door);
-            door->sector = (sector_t *)(door->sector - sectors);
-            continue;
-        }
+            if (th->function.acp1 == (actionf_p1)T_VerticalDoor)
+            {
+                door = (vldoor_t *)th;
+                P_WriteSpecial (tc_door, door->sector);
+                P_WriteLong (door->type);
+                P_WriteLong (door->topheight);
+                P_WriteLong (door->speed);
+                P_WriteLong (door->direction);
+                P_WriteLong (door->topwait);
+                P_WriteLong (door->topcountdown);
+                continue;
+            }
 
-        if (th->function.acp1 == (actionf_p1)T_MoveFloor)
-        {
-            *save_p++ = tc_floor;
-            PADSAVEP();
-            floor = (floormove_t *)save_p;
-            memcpy (floor, th, sizeof(*floor));
-            save_p += sizeof(*floor);
-            floor->sector = (sector_t *)(floor->sector - sectors);
-            continue;
-        }
+            if (th->function.acp1 == (actionf_p1)T_MoveFloor)
+            {
+                floor = (floormove_t *)th;
+                P_WriteSpecial (tc_floor, floor->sector);
+                P_WriteLong (floor->type);
+                P_WriteByte (floor->crush);
+                P_WriteLong (floor->direction);
+                P_WriteLong (floor->newspecial);
+                P_WriteShort (floor->texture);
+                P_WriteLong (floor->floordestheight);
+                P_WriteLong (floor->speed);
+                continue;
+            }
 
-        if (th->function.acp1 == (actionf_p1)T_PlatRaise)
-        {
-            *save_p++ = tc_plat;
-            PADSAVEP();
-            plat = (plat_t *)save_p;
-            memcpy (plat, th, sizeof(*plat));
-            save_p += sizeof(*plat);
-            plat->sector = (sector_t *)(plat->sector - sectors);
-            continue;
-        }
+            if (th->function.acp1 == (actionf_p1)T_PlatRaise)
+            {
+                plat = (plat_t *)th;
+                P_WriteSpecial (tc_plat, plat->sector);
+                P_WriteLong (plat->speed);
+                P_WriteLong (plat->low);
+                P_WriteLong (plat->high);
+                P_WriteLong (plat->wait);
+                P_WriteLong (plat->count);
+                P_WriteLong (plat->status);
+                P_WriteLong (plat->oldstatus);
+                P_WriteByte (plat->crush);
+                P_WriteLong (plat->tag);
+                P_WriteLong (plat->type);
+                continue;
+            }
 
-        if (th->function.acp1 == (actionf_p1)T_LightFlash)
-        {
-            *save_p++ = tc_flash;
-            PADSAVEP();
-            flash = (lightflash_t *)save_p;
-            memcpy (flash, th, sizeof(*flash));
-            save_p += sizeof(*flash);
-            flash->sector = (sector_t *)(flash->sector - sectors);
-            continue;
-        }
+            if (th->function.acp1 == (actionf_p1)T_LightFlash)
+            {
+                flash = (lightflash_t *)th;
+                P_WriteSpecial (tc_flash, flash->sector);
+                P_WriteLong (flash->count);
+                P_WriteLong (flash->maxlight);
+                P_WriteLong (flash->minlight);
+                P_WriteLong (flash->maxtime);
+                P_WriteLong (flash->mintime);
+                continue;
+            }
 
-        if (th->function.acp1 == (actionf_p1)T_StrobeFlash)
-        {
-            *save_p++ = tc_strobe;
-            PADSAVEP();
-            strobe = (strobe_t *)save_p;
-            memcpy (strobe, th, sizeof(*strobe));
-            save_p += sizeof(*strobe);
-            strobe->sector = (sector_t *)(strobe->sector - sectors);
-            continue;
-        }
+            if (th->function.acp1 == (actionf_p1)T_StrobeFlash)
+            {
+                strobe = (strobe_t *)th;
+                P_WriteSpecial (tc_strobe, strobe->sector);
+                P_WriteLong (strobe->count);
+                P_WriteLong (strobe->minlight);
+                P_WriteLong (strobe->maxlight);
+                P_WriteLong (strobe->darktime);
+                P_WriteLong (strobe->brighttime);
+                continue;
+            }
 
-        if (th->function.acp1 == (actionf_p1)T_Glow)
-        {
-            *save_p++ = tc_glow;
-            PADSAVEP();
-            glow = (glow_t *)save_p;
-            memcpy (glow, th, sizeof(*glow));
-            save_p += sizeof(*glow);
-            glow->sector = (sector_t *)(glow->sector - sectors);
-            continue;
+            if (th->function.acp1 == (actionf_p1)T_Glow)
+            {
+                glow = (glow_t *)th;
+                P_WriteSpecial (tc_glow, glow->sector);
+                P_WriteLong (glow->minlight);
+                P_WriteLong (glow->maxlight);
+                P_WriteLong (glow->direction);
+                continue;
+            }
         }
     }
 
     // add a terminating marker
-    *save_p++ = tc_endspecials;
+    P_WriteByte (tc_endspecials);
 
 }
 
@@ -474,7 +1041,7 @@ void P_ArchiveSpecials (void)
 //
 // P_UnArchiveSpecials
 //
-void P_UnArchiveSpecials (void)
+static void P_UnArchiveSpecials (void)
 {
     byte                tclass;
     ceiling_t*          ceiling;
@@ -489,92 +1056,115 @@ void P_UnArchiveSpecials (void)
     // read in saved thinkers
     while (1)
     {
-        tclass = *save_p++;
+        tclass = P_ReadByte ();
         switch (tclass)
         {
           case tc_endspecials:
             return;     // end of list
 
           case tc_ceiling:
-            PADSAVEP();
             ceiling = Z_Malloc (sizeof(*ceiling), PU_LEVEL, NULL);
-            memcpy (ceiling, save_p, sizeof(*ceiling));
-            save_p += sizeof(*ceiling);
-            ceiling->sector = &sectors[(int)ceiling->sector];
+            ceiling->sector = P_ReadSpecial ();
             ceiling->sector->specialdata = ceiling;
 
-            if (ceiling->thinker.function.acp1)
+            if (P_ReadByte ())
                 ceiling->thinker.function.acp1 = (actionf_p1)T_MoveCeiling;
+            else
+                ceiling->thinker.function.acv = (actionf_v)NULL;
+
+            ceiling->type = P_ReadLong ();
+            ceiling->bottomheight = P_ReadLong ();
+            ceiling->topheight = P_ReadLong ();
+            ceiling->speed = P_ReadLong ();
+            ceiling->crush = P_ReadByte ();
+            ceiling->direction = P_ReadLong ();
+            ceiling->tag = P_ReadLong ();
+            ceiling->olddirection = P_ReadLong ();
 
             P_AddThinker (&ceiling->thinker);
             P_AddActiveCeiling(ceiling);
             break;
 
           case tc_door:
-            PADSAVEP();
             door = Z_Malloc (sizeof(*door), PU_LEVEL, NULL);
-            memcpy (door, save_p, sizeof(*door));
-            save_p += sizeof(*door);
-            door->sector = &sectors[(int)door->sector];
+            door->sector = P_ReadSpecial ();
             door->sector->specialdata = door;
+            door->type = P_ReadLong ();
+            door->topheight = P_ReadLong ();
+            door->speed = P_ReadLong ();
+            door->direction = P_ReadLong ();
+            door->topwait = P_ReadLong ();
+            door->topcountdown = P_ReadLong ();
             door->thinker.function.acp1 = (actionf_p1)T_VerticalDoor;
             P_AddThinker (&door->thinker);
             break;
 
           case tc_floor:
-            PADSAVEP();
             floor = Z_Malloc (sizeof(*floor), PU_LEVEL, NULL);
-            memcpy (floor, save_p, sizeof(*floor));
-            save_p += sizeof(*floor);
-            floor->sector = &sectors[(int)floor->sector];
+            floor->sector = P_ReadSpecial ();
             floor->sector->specialdata = floor;
+            floor->type = P_ReadLong ();
+            floor->crush = P_ReadByte ();
+            floor->direction = P_ReadLong ();
+            floor->newspecial = P_ReadLong ();
+            floor->texture = P_ReadShort ();
+            floor->floordestheight = P_ReadLong ();
+            floor->speed = P_ReadLong ();
             floor->thinker.function.acp1 = (actionf_p1)T_MoveFloor;
             P_AddThinker (&floor->thinker);
             break;
 
           case tc_plat:
-            PADSAVEP();
             plat = Z_Malloc (sizeof(*plat), PU_LEVEL, NULL);
-            memcpy (plat, save_p, sizeof(*plat));
-            save_p += sizeof(*plat);
-            plat->sector = &sectors[(int)plat->sector];
+            plat->sector = P_ReadSpecial ();
             plat->sector->specialdata = plat;
-
-            if (plat->thinker.function.acp1)
-                plat->thinker.function.acp1 = (actionf_p1)T_PlatRaise;
-
+            plat->speed = P_ReadLong ();
+            plat->low = P_ReadLong ();
+            plat->high = P_ReadLong ();
+            plat->wait = P_ReadLong ();
+            plat->count = P_ReadLong ();
+            plat->status = P_ReadLong ();
+            plat->oldstatus = P_ReadLong ();
+            plat->crush = P_ReadByte ();
+            plat->tag = P_ReadLong ();
+            plat->type = P_ReadLong ();
+            plat->thinker.function.acp1 = (actionf_p1)T_PlatRaise;
             P_AddThinker (&plat->thinker);
             P_AddActivePlat(plat);
             break;
 
           case tc_flash:
-            PADSAVEP();
             flash = Z_Malloc (sizeof(*flash), PU_LEVEL, NULL);
-            memcpy (flash, save_p, sizeof(*flash));
-            save_p += sizeof(*flash);
-            flash->sector = &sectors[(int)flash->sector];
+            flash->sector = P_ReadSpecial ();
+            flash->count = P_ReadLong ();
+            flash->maxlight = P_ReadLong ();
+            flash->minlight = P_ReadLong ();
+            flash->maxtime = P_ReadLong ();
+            flash->mintime = P_ReadLong ();
             flash->thinker.function.acp1 = (actionf_p1)T_LightFlash;
             P_AddThinker (&flash->thinker);
             break;
 
           case tc_strobe:
-            PADSAVEP();
             strobe = Z_Malloc (sizeof(*strobe), PU_LEVEL, NULL);
-            memcpy (strobe, save_p, sizeof(*strobe));
-            save_p += sizeof(*strobe);
-            strobe->sector = &sectors[(int)strobe->sector];
+            strobe->sector = P_ReadSpecial ();
+            strobe->count = P_ReadLong ();
+            strobe->minlight = P_ReadLong ();
+            strobe->maxlight = P_ReadLong ();
+            strobe->darktime = P_ReadLong ();
+            strobe->brighttime = P_ReadLong ();
             strobe->thinker.function.acp1 = (actionf_p1)T_StrobeFlash;
-            P_AddThinker (&strobe->thinker);
+            P_AddLightThinker (&strobe->thinker);
             break;
 
           case tc_glow:
-            PADSAVEP();
             glow = Z_Malloc (sizeof(*glow), PU_LEVEL, NULL);
-            memcpy (glow, save_p, sizeof(*glow));
-            save_p += sizeof(*glow);
-            glow->sector = &sectors[(int)glow->sector];
+            glow->sector = P_ReadSpecial ();
+            glow->minlight = P_ReadLong ();
+            glow->maxlight = P_ReadLong ();
+            glow->direction = P_ReadLong ();
             glow->thinker.function.acp1 = (actionf_p1)T_Glow;
-            P_AddThinker (&glow->thinker);
+            P_AddLightThinker (&glow->thinker);
             break;
 
           default:
@@ -586,3 +1176,42 @@ void P_UnArchiveSpecials (void)
 
 }
 
+
+
+//
+// P_ArchiveGame
+// Everything after the savegame header.
+//
+void P_ArchiveGame (void)
+{
+    P_NumberMobjs ();
+
+    P_ArchivePlayers ();
+    P_ArchiveWorld ();
+    P_ArchiveThinkers ();
+    P_ArchiveSpecials ();
+
+    Z_Free (mobjhash);
+    Z_Free (mobjhashnum);
+}
+
+
+//
+// P_UnArchiveGame
+// The level must have been set up first.
+//
+void P_UnArchiveGame (void)
+{
+    int         i;
+
+    P_UnArchivePlayers ();
+    P_UnArchiveWorld ();
+    P_UnArchiveThinkers ();
+    P_UnArchiveSpecials ();
+
+    for (i=0 ; i<MAXPLAYERS ; i++)
+        if (playeringame[i])
+            players[i].attacker = P_NumMobj ((size_t)players[i].attacker);
+
+    Z_Free (mobjtable);
+}
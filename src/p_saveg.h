@@ -30,18 +30,26 @@
 #endif
 
 
+// Version of the savegame layout, written after VERSION.
+#define SAVEGAMEFORMAT  3
+
 // Persistent storage/archiving.
 // These are the load / save game routines.
-void P_ArchivePlayers (void);
-void P_UnArchivePlayers (void);
-void P_ArchiveWorld (void);
-void P_UnArchiveWorld (void);
-void P_ArchiveThinkers (void);
-void P_UnArchiveThinkers (void);
-void P_ArchiveSpecials (void);
-void P_UnArchiveSpecials (void);
-
-extern byte*            save_p;
+boolean P_OpenSaveGame (char* name, boolean writing);
+boolean P_CloseSaveGame (void);
+
+void    P_WriteBytes (void* data, int length);
+void    P_WriteByte (int value);
+void    P_WriteShort (int value);
+void    P_WriteLong (int value);
+void    P_ReadBytes (void* data, int length);
+int     P_ReadByte (void);
+int     P_ReadShort (void);
+int     P_ReadLong (void);
+
+void    P_SnapshotWorld (void);
+void    P_ArchiveGame (void);
+void    P_UnArchiveGame (void);
 
 
 #endif
@@ -28,10 +28,12 @@ rcsid[] = "$Id: p_setup.c,v 1.5 1997/02/03 22:45:12 b1 Exp $";
 
 
 #include <math.h>
+#include <stdio.h>
 
 #include "z_zone.h"
 
 #include "m_swap.h"
+#include "m_argv.h"
 #include "m_bbox.h"
 
 #include "g_game.h"
@@ -41,6 +43,7 @@ rcsid[] = "$Id: p_setup.c,v 1.5 1997/02/03 22:45:12 b1 Exp $";
 
 #include "doomdef.h"
 #include "p_local.h"
+#include "p_saveg.h"
 
 #include "s_sound.h"
 
@@ -71,6 +74,7 @@ node_t*         nodes;
 
 int             numlines;
 line_t*         lines;
+int*            linevalidcount;
 
 int             numsides;
 side_t*         sides;
@@ -86,15 +90,20 @@ side_t*         sides;
 // Blockmap size.
 int             bmapwidth;
 int             bmapheight;     // size in mapblocks
-short*          blockmap;       // int for larger maps
-// offsets in blockmap are from here
-short*          blockmaplump;
+// Per block, where its lines start in blocklines;
+//  block i has blocklines[blockmap[i]] to blocklines[blockmap[i+1]-1].
+int*            blockmap;
+int*            blocklines;
 // origin of block map
 fixed_t         bmaporgx;
 fixed_t         bmaporgy;
 // for thing chains
 mobj_t**        blocklinks;
 
+// the sector line tables, built by P_GroupLines
+static line_t** sectorlines;
+static int      numsectorlines;
+
 
 // REJECT
 // For fast sight rejection.
@@ -367,6 +376,8 @@ void P_LoadLineDefs (int lump)
     numlines = W_LumpLength (lump) / sizeof(maplinedef_t);
     lines = Z_Malloc (numlines*sizeof(line_t),PU_LEVEL,0);
     memset (lines, 0, numlines*sizeof(line_t));
+    linevalidcount = Z_Malloc (numlines*sizeof(int),PU_LEVEL,0);
+    memset (linevalidcount, 0, numlines*sizeof(int));
     data = W_CacheLumpNum (lump,PU_STATIC);
 
     mld = (maplinedef_t *)data;
@@ -464,25 +475,197 @@ void P_LoadSideDefs (int lump)
 }
 
 
+//
+// P_CheckBlockMap
+// Returns how many line numbers the BLOCKMAP lump lists,
+// or -1 if it can't be used. Offsets are unsigned 16 bit
+// counts of shorts, so a lump over 128 KB can't reach its
+// tail and has wrapped: it is rebuilt instead.
+//
+static int P_CheckBlockMap (short* data, int count)
+{
+    int         cells;
+    int         total;
+    int         off;
+    int         i;
+
+    if (count < 4 || count > 0x10000
+        || SHORT(data[2]) <= 0 || SHORT(data[3]) <= 0)
+        return -1;
+
+    cells = SHORT(data[2]) * SHORT(data[3]);
+    if (4+cells > count)
+        return -1;
+
+    total = 0;
+    for (i=0 ; i<cells ; i++)
+    {
+        off = (unsigned short)SHORT(data[4+i]);
+        if (off < 4+cells || off >= count)
+            return -1;
+
+        for ( ; off < count && SHORT(data[off]) != -1 ; off++, total++)
+            if ((unsigned short)SHORT(data[off]) >= numlines)
+                return -1;
+
+        if (off == count)
+            return -1;  // list not terminated
+    }
+
+    return total;
+}
+
+
+//
+// P_CreateBlockMap
+// Builds the blockmap from the linedefs,
+// for levels whose BLOCKMAP is missing or unusable.
+// Every line goes in each block its bounding box touches
+// and its extension crosses, in line order.
+//
+static void P_CreateBlockMap (void)
+{
+    int         minx;
+    int         miny;
+    int         maxx;
+    int         maxy;
+    int         cells;
+    int*        fill;
+    fixed_t     box[4];
+    line_t*     ld;
+    int         pass;
+    int         xl;
+    int         xh;
+    int         yl;
+    int         yh;
+    int         bx;
+    int         by;
+    int         i;
+
+    minx = maxx = vertexes[0].x>>FRACBITS;
+    miny = maxy = vertexes[0].y>>FRACBITS;
+    for (i=1 ; i<numvertexes ; i++)
+    {
+        if ((vertexes[i].x>>FRACBITS) < minx)
+            minx = vertexes[i].x>>FRACBITS;
+        if ((vertexes[i].x>>FRACBITS) > maxx)
+            maxx = vertexes[i].x>>FRACBITS;
+        if ((vertexes[i].y>>FRACBITS) < miny)
+            miny = vertexes[i].y>>FRACBITS;
+        if ((vertexes[i].y>>FRACBITS) > maxy)
+            maxy = vertexes[i].y>>FRACBITS;
+    }
+
+    bmaporgx = minx<<FRACBITS;
+    bmaporgy = miny<<FRACBITS;
+    bmapwidth = ((maxx-minx)>>MAPBTOFRAC) + 1;
+    bmapheight = ((maxy-miny)>>MAPBTOFRAC) + 1;
+    cells = bmapwidth*bmapheight;
+
+    // First pass counts the lines of each block,
+    //  the second stores them.
+    blockmap = Z_Malloc ((cells+1)*sizeof(int), PU_LEVEL, 0);
+    memset (blockmap, 0, (cells+1)*sizeof(int));
+    fill = NULL;
+
+    for (pass=0 ; pass<2 ; pass++)
+    {
+        for (i=0, ld=lines ; i<numlines ; i++, ld++)
+        {
+            xl = (ld->bbox[BOXLEFT] - bmaporgx)>>MAPBLOCKSHIFT;
+            xh = (ld->bbox[BOXRIGHT] - bmaporgx)>>MAPBLOCKSHIFT;
+            yl = (ld->bbox[BOXBOTTOM] - bmaporgy)>>MAPBLOCKSHIFT;
+            yh = (ld->bbox[BOXTOP] - bmaporgy)>>MAPBLOCKSHIFT;
+
+            for (bx=xl ; bx<=xh ; bx++)
+            {
+                for (by=yl ; by<=yh ; by++)
+                {
+                    box[BOXLEFT] = bmaporgx + (bx<<MAPBLOCKSHIFT);
+                    box[BOXRIGHT] = box[BOXLEFT] + MAPBLOCKSIZE;
+                    box[BOXBOTTOM] = bmaporgy + (by<<MAPBLOCKSHIFT);
+                    box[BOXTOP] = box[BOXBOTTOM] + MAPBLOCKSIZE;
+
+                    if (ld->slopetype != ST_HORIZONTAL
+                        && ld->slopetype != ST_VERTICAL
+                        && P_BoxOnLineSide (box, ld) != -1)
+                        continue;
+
+                    if (!pass)
+                        blockmap[by*bmapwidth+bx+1]++;
+                    else
+                        blocklines[fill[by*bmapwidth+bx]++] = i;
+                }
+            }
+        }
+
+        if (!pass)
+        {
+            for (i=0 ; i<cells ; i++)
+                blockmap[i+1] += blockmap[i];
+
+            blocklines = Z_Malloc ((blockmap[cells]+1)*sizeof(int),
+                                   PU_LEVEL, 0);
+            fill = Z_Malloc (cells*sizeof(int), PU_STATIC, 0);
+            memcpy (fill, blockmap, cells*sizeof(int));
+        }
+    }
+
+    Z_Free (fill);
+}
+
+
 //
 // P_LoadBlockMap
+// Unpacks the BLOCKMAP lump to 32 bit offsets and line
+// numbers, without the list terminators, or builds one
+// when the lump can't be trusted. Needs the linedefs.
+// The dummy line 0 most builders put at the head of every
+// list is kept: PIT_CheckLine and P_PathTraverse see lines
+// in list order, and vanilla demos depend on it.
 //
 void P_LoadBlockMap (int lump)
 {
-    int         i;
+    short*      data;
+    short*      list;
     int         count;
+    int         total;
+    int         cells;
+    int         i;
 
-    blockmaplump = W_CacheLumpNum (lump,PU_LEVEL);
-    blockmap = blockmaplump+4;
     count = W_LumpLength (lump)/2;
+    data = count ? W_CacheLumpNum (lump,PU_STATIC) : NULL;
+    total = count ? P_CheckBlockMap (data, count) : -1;
 
-    for (i=0 ; i<count ; i++)
-        blockmaplump[i] = SHORT(blockmaplump[i]);
+    if (total < 0)
+    {
+        printf ("P_LoadBlockMap: rebuilding blockmap\n");
+        P_CreateBlockMap ();
+    }
+    else
+    {
+        bmaporgx = SHORT(data[0])<<FRACBITS;
+        bmaporgy = SHORT(data[1])<<FRACBITS;
+        bmapwidth = SHORT(data[2]);
+        bmapheight = SHORT(data[3]);
+        cells = bmapwidth*bmapheight;
 
-    bmaporgx = blockmaplump[0]<<FRACBITS;
-    bmaporgy = blockmaplump[1]<<FRACBITS;
-    bmapwidth = blockmaplump[2];
-    bmapheight = blockmaplump[3];
+        blockmap = Z_Malloc ((cells+1)*sizeof(int), PU_LEVEL, 0);
+        blocklines = Z_Malloc ((total+1)*sizeof(int), PU_LEVEL, 0);
+
+        total = 0;
+        for (i=0 ; i<cells ; i++)
+        {
+            blockmap[i] = total;
+            list = data + (unsigned short)SHORT(data[4+i]);
+            for ( ; SHORT(*list) != -1 ; list++)
+                blocklines[total++] = (unsigned short)SHORT(*list);
+        }
+        blockmap[cells] = total;
+    }
+
+    if (data)
+        Z_Free (data);
 
     // clear out mobj chains
     count = sizeof(*blocklinks)* bmapwidth*bmapheight;
@@ -535,6 +718,8 @@ void P_GroupLines (void)
 
     // build line tables for each sector
     linebuffer = Z_Malloc (total*4, PU_LEVEL, 0);
+    sectorlines = linebuffer;
+    numsectorlines = total;
     sector = sectors;
     for (i=0 ; i<numsectors ; i++, sector++)
     {
@@ -578,6 +763,343 @@ void P_GroupLines (void)
 }
 
 
+//
+// LEVEL CACHE
+// The level as built by the loaders and P_GroupLines is
+//  written to a file per map, so later loads of the map
+//  are one read and a pass of pointer fixups.
+// Pointers are stored as 1 based indices into their array,
+//  0 for NULL. The file holds for one build (struct layout)
+//  and one lump directory.
+//
+typedef struct
+{
+    char        identification[4];      // should be "LVC2"
+    unsigned    key;
+    int         layout[8];
+
+    int         numvertexes;
+    int         numsectors;
+    int         numsides;
+    int         numlines;
+    int         numsubsectors;
+    int         numnodes;
+    int         numsegs;
+    int         numsectorlines;
+
+    int         bmapwidth;
+    int         bmapheight;
+    int         numblocklines;
+    fixed_t     bmaporgx;
+    fixed_t     bmaporgy;
+
+} levelcacheheader_t;
+
+// The arrays follow in the header order, blockmap before
+//  blocklines, each padded to 8 bytes.
+#define LEVELALIGN(n)   (((n)+7)&~7)
+
+#define PTRTOINDEX(p,base)      ((p) ? (void *)((p)-(base)+1) : NULL)
+#define INDEXTOPTR(p,base)      ((p) ? (base)+((size_t)(p)-1) : NULL)
+
+
+static void P_LevelCacheLayout (int* layout)
+{
+    layout[0] = sizeof(void *);
+    layout[1] = sizeof(vertex_t);
+    layout[2] = sizeof(sector_t);
+    layout[3] = sizeof(side_t);
+    layout[4] = sizeof(line_t);
+    layout[5] = sizeof(subsector_t);
+    layout[6] = sizeof(node_t);
+    layout[7] = sizeof(seg_t);
+}
+
+
+static void P_LevelCacheHeader (levelcacheheader_t* header, unsigned key)
+{
+    memset (header, 0, sizeof(*header));
+    memcpy (header->identification, "LVC2", 4);
+    header->key = key;
+    P_LevelCacheLayout (header->layout);
+
+    header->numvertexes = numvertexes;
+    header->numsectors = numsectors;
+    header->numsides = numsides;
+    header->numlines = numlines;
+    header->numsubsectors = numsubsectors;
+    header->numnodes = numnodes;
+    header->numsegs = numsegs;
+    header->numsectorlines = numsectorlines;
+
+    header->bmapwidth = bmapwidth;
+    header->bmapheight = bmapheight;
+    header->numblocklines = blockmap[bmapwidth*bmapheight];
+    header->bmaporgx = bmaporgx;
+    header->bmaporgy = bmaporgy;
+}
+
+
+// Bytes of level data after the header.
+static int P_LevelCacheSize (levelcacheheader_t* header)
+{
+    return LEVELALIGN(header->numvertexes*sizeof(vertex_t))
+        + LEVELALIGN(header->numsectors*sizeof(sector_t))
+        + LEVELALIGN(header->numsides*sizeof(side_t))
+        + LEVELALIGN(header->numlines*sizeof(line_t))
+        + LEVELALIGN(header->numsubsectors*sizeof(subsector_t))
+        + LEVELALIGN(header->numnodes*sizeof(node_t))
+        + LEVELALIGN(header->numsegs*sizeof(seg_t))
+        + LEVELALIGN(header->numsectorlines*sizeof(line_t *))
+        + LEVELALIGN((header->bmapwidth*header->bmapheight+1)*sizeof(int))
+        + LEVELALIGN(header->numblocklines*sizeof(int));
+}
+
+
+static boolean
+P_WriteLevelCacheData
+( FILE*         file,
+  void*         data,
+  int           length )
+{
+    return fwrite (data, 1, length, file) == length;
+}
+
+
+static boolean
+P_PadLevelCache
+( FILE*         file,
+  int           length )
+{
+    static byte pad[8];
+
+    return P_WriteLevelCacheData (file, pad, LEVELALIGN(length)-length);
+}
+
+
+//
+// P_WriteLevelCache
+// A cache that fails to write is removed.
+//
+static void P_WriteLevelCache (char* name, unsigned key)
+{
+    levelcacheheader_t  header;
+    FILE*               file;
+    sector_t            sec;
+    side_t              side;
+    line_t              line;
+    subsector_t         ss;
+    seg_t               seg;
+    line_t*             li;
+    int                 i;
+    boolean             ok;
+
+    file = fopen (name, "wb");
+    if (!file)
+        return;         // can't write the file, but don't complain
+
+    P_LevelCacheHeader (&header, key);
+    ok = P_WriteLevelCacheData (file, &header, sizeof(header));
+
+    ok = ok && P_WriteLevelCacheData (file, vertexes,
+                                      numvertexes*sizeof(vertex_t))
+        && P_PadLevelCache (file, numvertexes*sizeof(vertex_t));
+
+    for (i=0 ; ok && i<numsectors ; i++)
+    {
+        sec = sectors[i];
+        sec.lines = PTRTOINDEX(sec.lines, sectorlines);
+        ok = P_WriteLevelCacheData (file, &sec, sizeof(sec));
+    }
+    ok = ok && P_PadLevelCache (file, numsectors*sizeof(sector_t));
+
+    for (i=0 ; ok && i<numsides ; i++)
+    {
+        side = sides[i];
+        side.sector = PTRTOINDEX(side.sector, sectors);
+        ok = P_WriteLevelCacheData (file, &side, sizeof(side));
+    }
+    ok = ok && P_PadLevelCache (file, numsides*sizeof(side_t));
+
+    for (i=0 ; ok && i<numlines ; i++)
+    {
+        line = lines[i];
+        line.v1 = PTRTOINDEX(line.v1, vertexes);
+        line.v2 = PTRTOINDEX(line.v2, vertexes);
+        line.frontsector = PTRTOINDEX(line.frontsector, sectors);
+        line.backsector = PTRTOINDEX(line.backsector, sectors);
+        ok = P_WriteLevelCacheData (file, &line, sizeof(line));
+    }
+    ok = ok && P_PadLevelCache (file, numlines*sizeof(line_t));
+
+    for (i=0 ; ok && i<numsubsectors ; i++)
+    {
+        ss = subsectors[i];
+        ss.sector = PTRTOINDEX(ss.sector, sectors);
+        ok = P_WriteLevelCacheData (file, &ss, sizeof(ss));
+    }
+    ok = ok && P_PadLevelCache (file, numsubsectors*sizeof(subsector_t));
+
+    ok = ok && P_WriteLevelCacheData (file, nodes, numnodes*sizeof(node_t))
+        && P_PadLevelCache (file, numnodes*sizeof(node_t));
+
+    for (i=0 ; ok && i<numsegs ; i++)
+    {
+        seg = segs[i];
+        seg.v1 = PTRTOINDEX(seg.v1, vertexes);
+        seg.v2 = PTRTOINDEX(seg.v2, vertexes);
+        seg.sidedef = PTRTOINDEX(seg.sidedef, sides);
+        seg.linedef = PTRTOINDEX(seg.linedef, lines);
+        seg.frontsector = PTRTOINDEX(seg.frontsector, sectors);
+        seg.backsector = PTRTOINDEX(seg.backsector, sectors);
+        ok = P_WriteLevelCacheData (file, &seg, sizeof(seg));
+    }
+    ok = ok && P_PadLevelCache (file, numsegs*sizeof(seg_t));
+
+    for (i=0 ; ok && i<numsectorlines ; i++)
+    {
+        li = PTRTOINDEX(sectorlines[i], lines);
+        ok = P_WriteLevelCacheData (file, &li, sizeof(li));
+    }
+    ok = ok && P_PadLevelCache (file, numsectorlines*sizeof(line_t *));
+
+    i = (bmapwidth*bmapheight+1)*sizeof(int);
+    ok = ok && P_WriteLevelCacheData (file, blockmap, i)
+        && P_PadLevelCache (file, i);
+
+    i = header.numblocklines*sizeof(int);
+    ok = ok && P_WriteLevelCacheData (file, blocklines, i)
+        && P_PadLevelCache (file, i);
+
+    if (fclose (file) || !ok)
+        remove (name);
+}
+
+
+//
+// P_LoadLevelCache
+// Returns false, changing nothing, if there is
+//  no cache file for this key.
+//
+static boolean P_LoadLevelCache (char* name, unsigned key)
+{
+    levelcacheheader_t  header;
+    int                 layout[8];
+    FILE*               file;
+    byte*               data;
+    int                 length;
+    int                 i;
+
+    file = fopen (name, "rb");
+    if (!file)
+        return false;
+
+    P_LevelCacheLayout (layout);
+
+    if (fread (&header, 1, sizeof(header), file) != sizeof(header)
+        || memcmp (header.identification, "LVC2", 4)
+        || header.key != key
+        || memcmp (header.layout, layout, sizeof(layout)))
+    {
+        fclose (file);
+        return false;
+    }
+
+    length = P_LevelCacheSize (&header);
+
+    fseek (file, 0, SEEK_END);
+    if (ftell (file) != sizeof(header) + length)
+    {
+        fclose (file);
+        return false;
+    }
+
+    data = Z_Malloc (length, PU_LEVEL, 0);
+    if (fseek (file, sizeof(header), SEEK_SET)
+        || fread (data, 1, length, file) != length)
+    {
+        I_Error ("P_LoadLevelCache: can't read %s", name);
+    }
+    fclose (file);
+
+    numvertexes = header.numvertexes;
+    numsectors = header.numsectors;
+    numsides = header.numsides;
+    numlines = header.numlines;
+    numsubsectors = header.numsubsectors;
+    numnodes = header.numnodes;
+    numsegs = header.numsegs;
+    numsectorlines = header.numsectorlines;
+
+    bmapwidth = header.bmapwidth;
+    bmapheight = header.bmapheight;
+    bmaporgx = header.bmaporgx;
+    bmaporgy = header.bmaporgy;
+
+    vertexes = (vertex_t *)data;
+    data += LEVELALIGN(numvertexes*sizeof(vertex_t));
+    sectors = (sector_t *)data;
+    data += LEVELALIGN(numsectors*sizeof(sector_t));
+    sides = (side_t *)data;
+    data += LEVELALIGN(numsides*sizeof(side_t));
+    lines = (line_t *)data;
+    data += LEVELALIGN(numlines*sizeof(line_t));
+    subsectors = (subsector_t *)data;
+    data += LEVELALIGN(numsubsectors*sizeof(subsector_t));
+    nodes = (node_t *)data;
+    data += LEVELALIGN(numnodes*sizeof(node_t));
+    segs = (seg_t *)data;
+    data += LEVELALIGN(numsegs*sizeof(seg_t));
+    sectorlines = (line_t **)data;
+    data += LEVELALIGN(numsectorlines*sizeof(line_t *));
+    blockmap = (int *)data;
+    data += LEVELALIGN((bmapwidth*bmapheight+1)*sizeof(int));
+    blocklines = (int *)data;
+
+    // fix up the pointers
+    for (i=0 ; i<numsectors ; i++)
+        sectors[i].lines = INDEXTOPTR(sectors[i].lines, sectorlines);
+
+    for (i=0 ; i<numsides ; i++)
+        sides[i].sector = INDEXTOPTR(sides[i].sector, sectors);
+
+    for (i=0 ; i<numlines ; i++)
+    {
+        lines[i].v1 = INDEXTOPTR(lines[i].v1, vertexes);
+        lines[i].v2 = INDEXTOPTR(lines[i].v2, vertexes);
+        lines[i].frontsector = INDEXTOPTR(lines[i].frontsector, sectors);
+        lines[i].backsector = INDEXTOPTR(lines[i].backsector, sectors);
+    }
+
+    for (i=0 ; i<numsubsectors ; i++)
+        subsectors[i].sector = INDEXTOPTR(subsectors[i].sector, sectors);
+
+    for (i=0 ; i<numsegs ; i++)
+    {
+        segs[i].v1 = INDEXTOPTR(segs[i].v1, vertexes);
+        segs[i].v2 = INDEXTOPTR(segs[i].v2, vertexes);
+        segs[i].sidedef = INDEXTOPTR(segs[i].sidedef, sides);
+        segs[i].linedef = INDEXTOPTR(segs[i].linedef, lines);
+        segs[i].frontsector = INDEXTOPTR(segs[i].frontsector, sectors);
+        segs[i].backsector = INDEXTOPTR(segs[i].backsector, sectors);
+    }
+
+    for (i=0 ; i<numsectorlines ; i++)
+        sectorlines[i] = INDEXTOPTR(sectorlines[i], lines);
+
+    // what P_LoadLineDefs and P_LoadBlockMap leave empty
+    linevalidcount = Z_Malloc (numlines*sizeof(int),PU_LEVEL,0);
+    memset (linevalidcount, 0, numlines*sizeof(int));
+
+    length = sizeof(*blocklinks)* bmapwidth*bmapheight;
+    blocklinks = Z_Malloc (length,PU_LEVEL, 0);
+    memset (blocklinks, 0, length);
+
+    return true;
+}
+
+
+
 //
 // P_SetupLevel
 //
@@ -591,6 +1113,9 @@ P_SetupLevel
     int         i;
     char        lumpname[9];
     int         lumpnum;
+    char        cachename[16];
+    unsigned    key;
+    boolean     usecache;
 
     totalkills = totalitems = totalsecret = wminfo.maxfrags = 0;
     wminfo.partime = 180;
@@ -619,8 +1144,11 @@ P_SetupLevel
         Z_FreeTags (PU_LEVEL, PU_PURGELEVEL-1);
 
 
-    // UNUSED W_Profile ();
+    // lump cache telemetry, from the level that just ended
+    if (M_CheckParm ("-lumpstats"))
+        W_Profile ();
     P_InitThinkers ();
+    P_ClearSightCache ();
 
     // if working with a devlopment map, reload it
     W_Reload ();
@@ -646,19 +1174,32 @@ P_SetupLevel
 
     leveltime = 0;
 
-    // note: most of this ordering is important
-    P_LoadBlockMap (lumpnum+ML_BLOCKMAP);
-    P_LoadVertexes (lumpnum+ML_VERTEXES);
-    P_LoadSectors (lumpnum+ML_SECTORS);
-    P_LoadSideDefs (lumpnum+ML_SIDEDEFS);
+    // reloadable maps change under us, never cache those
+    sprintf (cachename, "%s.dlc", lumpname);
+    key = W_DirectoryKey ();
+    usecache = !M_CheckParm ("-nomapcache")
+        && lumpinfo[lumpnum].handle != -1;
+
+    if (!usecache || !P_LoadLevelCache (cachename, key))
+    {
+        // note: most of this ordering is important
+        P_LoadVertexes (lumpnum+ML_VERTEXES);
+        P_LoadSectors (lumpnum+ML_SECTORS);
+        P_LoadSideDefs (lumpnum+ML_SIDEDEFS);
 
-    P_LoadLineDefs (lumpnum+ML_LINEDEFS);
-    P_LoadSubsectors (lumpnum+ML_SSECTORS);
-    P_LoadNodes (lumpnum+ML_NODES);
-    P_LoadSegs (lumpnum+ML_SEGS);
+        P_LoadLineDefs (lumpnum+ML_LINEDEFS);
+        P_LoadBlockMap (lumpnum+ML_BLOCKMAP);
+        P_LoadSubsectors (lumpnum+ML_SSECTORS);
+        P_LoadNodes (lumpnum+ML_NODES);
+        P_LoadSegs (lumpnum+ML_SEGS);
+
+        P_GroupLines ();
+
+        if (usecache)
+            P_WriteLevelCache (cachename, key);
+    }
 
     rejectmatrix = W_CacheLumpNum (lumpnum+ML_REJECT,PU_LEVEL);
-    P_GroupLines ();
 
     bodyqueslot = 0;
     deathmatch_p = deathmatchstarts;
@@ -682,6 +1223,9 @@ P_SetupLevel
     // set up world state
     P_SpawnSpecials ();
 
+    // base for the savegame world deltas
+    P_SnapshotWorld ();
+
     // build subsector connect matrix
     //  UNUSED P_ConnectSubsectors ();
 
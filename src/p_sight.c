@@ -48,6 +48,38 @@ fixed_t         t2y;
 int             sightcounts[2];
 
 
+//
+// Sight cache.
+// A trace only depends on the two positions and on sector
+//  heights, so results are kept keyed on the exact positions
+//  until any floor or ceiling moves. Monsters that stand still
+//  and look at a player who does too then skip the BSP walk.
+//
+#define SIGHTCACHESIZE          256
+
+typedef struct
+{
+    fixed_t     x1, y1, z1, h1;
+    fixed_t     x2, y2, z2, h2;
+    int         epoch;
+    boolean     result;
+
+} sightcache_t;
+
+static sightcache_t     sightcache[SIGHTCACHESIZE];
+static int              sightepoch = 1;
+
+
+//
+// P_ClearSightCache
+// Called whenever sector heights change.
+//
+void P_ClearSightCache (void)
+{
+    sightepoch++;
+}
+
+
 //
 // P_DivlineSide
 // Returns side 0 (front), 1 (back), or 2 (on).
@@ -169,10 +201,10 @@ boolean P_CrossSubsector (int num)
         line = seg->linedef;
 
         // allready checked other side?
-        if (line->validcount == validcount)
+        if (linevalidcount[line - lines] == validcount)
             continue;
 
-        line->validcount = validcount;
+        linevalidcount[line - lines] = validcount;
 
         v1 = line->v1;
         v2 = line->v2;
@@ -307,6 +339,7 @@ P_CheckSight
     int         pnum;
     int         bytenum;
     int         bitnum;
+    sightcache_t* sc;
 
     // First check for trivial rejection.
 
@@ -326,6 +359,19 @@ P_CheckSight
         return false;
     }
 
+    // Seen from the same spots since the world last changed?
+    sc = &sightcache[(((size_t)t1>>4) ^ ((size_t)t2>>6) ^ s2)
+                     & (SIGHTCACHESIZE-1)];
+
+    if (sc->epoch == sightepoch
+        && sc->x1 == t1->x && sc->y1 == t1->y
+        && sc->z1 == t1->z && sc->h1 == t1->height
+        && sc->x2 == t2->x && sc->y2 == t2->y
+        && sc->z2 == t2->z && sc->h2 == t2->height)
+    {
+        return sc->result;
+    }
+
     // An unobstructed LOS is possible.
     // Now look from eyes of t1 to any part of t2.
     sightcounts[1]++;
@@ -343,8 +389,20 @@ P_CheckSight
     strace.dx = t2->x - t1->x;
     strace.dy = t2->y - t1->y;
 
+    sc->x1 = t1->x;
+    sc->y1 = t1->y;
+    sc->z1 = t1->z;
+    sc->h1 = t1->height;
+    sc->x2 = t2->x;
+    sc->y2 = t2->y;
+    sc->z2 = t2->z;
+    sc->h2 = t2->height;
+    sc->epoch = sightepoch;
+
     // the head node is the last node output
-    return P_CrossBSPNode (numnodes-1);
+    sc->result = P_CrossBSPNode (numnodes-1);
+
+    return sc->result;
 }
 
 
@@ -46,8 +46,18 @@ int     leveltime;
 
 
 // Both the head and tail of the thinker list.
+// Mobjs, movers and the flickering lights stay in one list, in
+//  spawn order: they share P_Random and sector heights, and any
+//  other order would break demo sync.
 thinker_t       thinkercap;
 
+// T_Glow and T_StrobeFlash only ever touch lightlevel and never
+//  call P_Random, so they are kept apart and run after the rest.
+thinker_t       lightcap;
+
+// Thinkers removed during the walk, freed once it is over.
+static thinker_t*       freethinkers;
+
 
 //
 // P_InitThinkers
@@ -55,6 +65,7 @@ thinker_t       thinkercap;
 void P_InitThinkers (void)
 {
     thinkercap.prev = thinkercap.next  = &thinkercap;
+    lightcap.prev = lightcap.next = &lightcap;
 }
 
 
@@ -73,6 +84,19 @@ void P_AddThinker (thinker_t* thinker)
 }
 
 
+//
+// P_AddLightThinker
+// Same for T_Glow and T_StrobeFlash thinkers.
+//
+void P_AddLightThinker (thinker_t* thinker)
+{
+    lightcap.prev->next = thinker;
+    thinker->next = &lightcap;
+    thinker->prev = lightcap.prev;
+    lightcap.prev = thinker;
+}
+
+
 
 //
 // P_RemoveThinker
@@ -97,30 +121,78 @@ void P_AllocateThinker (thinker_t*      thinker)
 
 
 
+//
+// P_UnlinkThinker
+// Takes a removed thinker out of its list,
+// it is freed at the end of P_RunThinkers.
+//
+static thinker_t* P_UnlinkThinker (thinker_t* thinker)
+{
+    thinker_t*  next;
+
+    next = thinker->next;
+    next->prev = thinker->prev;
+    thinker->prev->next = next;
+
+    thinker->next = freethinkers;
+    freethinkers = thinker;
+
+    return next;
+}
+
+
 //
 // P_RunThinkers
 //
 void P_RunThinkers (void)
 {
     thinker_t*  currentthinker;
+    actionf_p1  func;
 
+    // Mostly mobjs, call those directly.
     currentthinker = thinkercap.next;
     while (currentthinker != &thinkercap)
     {
-        if ( currentthinker->function.acv == (actionf_v)(-1) )
+        func = currentthinker->function.acp1;
+
+        if (func == (actionf_p1)P_MobjThinker)
+            P_MobjThinker ((mobj_t *)currentthinker);
+        else if ( currentthinker->function.acv == (actionf_v)(-1) )
         {
             // time to remove it
-            currentthinker->next->prev = currentthinker->prev;
-            currentthinker->prev->next = currentthinker->next;
-            Z_Free (currentthinker);
+            currentthinker = P_UnlinkThinker (currentthinker);
+            continue;
         }
-        else
+        else if (func)
+            func (currentthinker);
+
+        currentthinker = currentthinker->next;
+    }
+
+    currentthinker = lightcap.next;
+    while (currentthinker != &lightcap)
+    {
+        func = currentthinker->function.acp1;
+
+        if (func == (actionf_p1)T_Glow)
+            T_Glow ((glow_t *)currentthinker);
+        else if (func == (actionf_p1)T_StrobeFlash)
+            T_StrobeFlash ((strobe_t *)currentthinker);
+        else if ( currentthinker->function.acv == (actionf_v)(-1) )
         {
-            if (currentthinker->function.acp1)
-                currentthinker->function.acp1 (currentthinker);
+            currentthinker = P_UnlinkThinker (currentthinker);
+            continue;
         }
+
         currentthinker = currentthinker->next;
     }
+
+    while (freethinkers)
+    {
+        currentthinker = freethinkers;
+        freethinkers = currentthinker->next;
+        Z_Free (currentthinker);
+    }
 }
 
 
@@ -31,6 +31,7 @@ rcsid[] = "$Id: r_bsp.c,v 1.4 1997/02/03 22:45:12 b1 Exp $";
 #include "m_bbox.h"
 
 #include "i_system.h"
+#include "z_zone.h"
 
 #include "r_main.h"
 #include "r_plane.h"
@@ -50,8 +51,9 @@ line_t*         linedef;
 sector_t*       frontsector;
 sector_t*       backsector;
 
-drawseg_t       drawsegs[MAXDRAWSEGS];
+drawseg_t*      drawsegs;
 drawseg_t*      ds_p;
+int             maxdrawsegs;
 
 
 void
@@ -62,12 +64,35 @@ R_StoreWallRange
 
 
 
+//
+// R_CheckDrawSegs
+// Makes room for one more drawseg.
+//
+void R_CheckDrawSegs (void)
+{
+    int         count;
+    int         newmax;
+
+    if (ds_p && ds_p < drawsegs+maxdrawsegs)
+        return;
+
+    count = ds_p - drawsegs;
+    newmax = maxdrawsegs ? maxdrawsegs*2 : 128;
+
+    drawsegs = Z_GrowArray (drawsegs, count, newmax, sizeof(*drawsegs));
+    maxdrawsegs = newmax;
+    ds_p = drawsegs + count;
+}
+
+
 //
 // R_ClearDrawSegs
 //
 void R_ClearDrawSegs (void)
 {
     ds_p = drawsegs;
+
+    R_CheckDrawSegs ();
 }
 
 
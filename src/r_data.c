@@ -29,11 +29,14 @@ rcsid[] = "$Id: r_data.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 
 
 #include  <alloca.h>
+#include  <stdio.h>
+#include  <stdlib.h>
 
 
 #include "i_system.h"
 #include "z_zone.h"
 
+#include "m_argv.h"
 #include "m_swap.h"
 
 #include "w_wad.h"
@@ -215,6 +218,55 @@ R_DrawColumnInCache
 
 
 
+//
+// TEXTURE CACHE
+// The column lookups and every composite are written to a file
+//  on the first run, so later runs skip R_GenerateLookup and
+//  nothing is composited during play.
+// The file only holds for the lump directory and texture
+//  definitions its key was computed from.
+// If the file can be mapped the composites are used in place,
+//  else they are read back from it instead of being rebuilt.
+//
+#define TEXCACHENAME    "doomtex.dtc"
+
+typedef struct
+{
+    char        identification[4];      // should be "TXC1"
+    unsigned    key;
+    int         numtextures;
+
+} texcacheheader_t;
+
+// After the header:
+//  int compositesize[numtextures],
+//  short collump[width], unsigned short colofs[width] per texture,
+//  then the composites, each padded to 4 bytes.
+
+static FILE*            texcachefile;
+static int*             texturecompositepos;
+
+
+//
+// R_ReadComposite
+// Reads a composite back from the open texture cache.
+//
+static void R_ReadComposite (int texnum)
+{
+    int         size;
+
+    size = texturecompositesize[texnum];
+    Z_Malloc (size, PU_CACHE, &texturecomposite[texnum]);
+
+    if (fseek (texcachefile, texturecompositepos[texnum], SEEK_SET)
+        || fread (texturecomposite[texnum], 1, size, texcachefile) != size)
+    {
+        I_Error ("R_ReadComposite: can't read texture %i from "
+                 TEXCACHENAME, texnum);
+    }
+}
+
+
 //
 // R_GenerateComposite
 // Using the texture definition,
@@ -235,6 +287,13 @@ void R_GenerateComposite (int texnum)
     short*              collump;
     unsigned short*     colofs;
 
+    // Already built in the texture cache file?
+    if (texcachefile)
+    {
+        R_ReadComposite (texnum);
+        return;
+    }
+
     texture = textures[texnum];
 
     block = Z_Malloc (texturecompositesize[texnum],
@@ -372,6 +431,209 @@ void R_GenerateLookup (int texnum)
 
 
 
+//
+// R_TextureCacheKey
+// Mixes the lump directory and the texture definitions.
+//
+static unsigned R_TextureCacheKey (void)
+{
+    texture_t*  texture;
+    texpatch_t* patch;
+    unsigned    key;
+    int         i;
+    int         j;
+
+    key = W_DirectoryKey ()*31 + numtextures;
+    for (i=0 ; i<numtextures ; i++)
+    {
+        texture = textures[i];
+        key = key*31 + texture->width;
+        key = key*31 + texture->height;
+
+        for (j=0, patch = texture->patches ; j<texture->patchcount ; j++, patch++)
+        {
+            key = key*31 + patch->originx;
+            key = key*31 + patch->originy;
+            key = key*31 + patch->patch;
+        }
+    }
+    return key;
+}
+
+
+//
+// R_ReadTextureCache
+// From the mapping if there is one, else from the file.
+//
+static boolean
+R_ReadTextureCache
+( FILE*         file,
+  byte*         base,
+  int           pos,
+  void*         dest,
+  int           length )
+{
+    if (base)
+    {
+        memcpy (dest, base+pos, length);
+        return true;
+    }
+
+    return !fseek (file, pos, SEEK_SET)
+        && fread (dest, 1, length, file) == length;
+}
+
+
+//
+// R_LoadTextureCache
+// Returns false, changing nothing, if there is
+//  no cache file for this key.
+//
+static boolean R_LoadTextureCache (unsigned key)
+{
+    texcacheheader_t    header;
+    FILE*               file;
+    byte*               base;
+    int*                sizes;
+    int                 length;
+    int                 pos;
+    int                 i;
+
+    file = fopen (TEXCACHENAME, "rb");
+    if (!file)
+        return false;
+
+    if (fread (&header, 1, sizeof(header), file) != sizeof(header)
+        || strncmp (header.identification, "TXC1", 4)
+        || header.key != key
+        || header.numtextures != numtextures)
+    {
+        fclose (file);
+        return false;
+    }
+
+    sizes = alloca (numtextures*sizeof(*sizes));
+    if (fread (sizes, 1, numtextures*sizeof(*sizes), file)
+        != numtextures*sizeof(*sizes))
+    {
+        fclose (file);
+        return false;
+    }
+
+    // the layout follows from the sizes, so a short file is stale
+    length = sizeof(header) + numtextures*sizeof(*sizes);
+    for (i=0 ; i<numtextures ; i++)
+    {
+        if (sizes[i] < 0)
+            length = -1;
+        length += textures[i]->width*4 + ((sizes[i]+3)&~3);
+    }
+
+    fseek (file, 0, SEEK_END);
+    if (length < 0 || ftell (file) != length)
+    {
+        fclose (file);
+        return false;
+    }
+
+    base = I_MapWadFile (fileno (file), length);
+
+    memcpy (texturecompositesize, sizes, numtextures*sizeof(*sizes));
+    pos = sizeof(header) + numtextures*sizeof(*sizes);
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+        length = textures[i]->width*2;
+
+        if (!R_ReadTextureCache (file, base, pos,
+                                 texturecolumnlump[i], length)
+            || !R_ReadTextureCache (file, base, pos+length,
+                                    texturecolumnofs[i], length))
+        {
+            I_Error ("R_LoadTextureCache: can't read " TEXCACHENAME);
+        }
+        pos += length*2;
+    }
+
+    if (!base)
+    {
+        texturecompositepos = Z_Malloc (numtextures*4, PU_STATIC, 0);
+        texcachefile = file;
+    }
+    else
+        fclose (file);
+
+    for (i=0 ; i<numtextures ; i++)
+    {
+        if (base && sizes[i])
+            texturecomposite[i] = base + pos;
+        else
+            texturecomposite[i] = 0;
+
+        if (!base)
+            texturecompositepos[i] = pos;
+
+        pos += (sizes[i]+3)&~3;
+    }
+
+    return true;
+}
+
+
+//
+// R_WriteTextureCache
+// Composites every texture while writing the file.
+// A cache that fails to write is removed.
+//
+static void R_WriteTextureCache (unsigned key)
+{
+    texcacheheader_t    header;
+    FILE*               file;
+    int                 size;
+    int                 pad;
+    int                 i;
+    boolean             ok;
+
+    file = fopen (TEXCACHENAME, "wb");
+    if (!file)
+        return;         // can't write the file, but don't complain
+
+    memcpy (header.identification, "TXC1", 4);
+    header.key = key;
+    header.numtextures = numtextures;
+
+    ok = fwrite (&header, sizeof(header), 1, file) == 1
+        && fwrite (texturecompositesize, 4, numtextures, file) == numtextures;
+
+    for (i=0 ; ok && i<numtextures ; i++)
+    {
+        size = textures[i]->width;
+        ok = fwrite (texturecolumnlump[i], 2, size, file) == size
+            && fwrite (texturecolumnofs[i], 2, size, file) == size;
+    }
+
+    pad = 0;
+    for (i=0 ; ok && i<numtextures ; i++)
+    {
+        size = texturecompositesize[i];
+        if (!size)
+            continue;
+
+        R_GenerateComposite (i);
+        ok = fwrite (texturecomposite[i], 1, size, file) == size
+            && fwrite (&pad, 1, -size&3, file) == (-size&3);
+
+        // R_LoadTextureCache repoints texturecomposite[i],
+        //  so the zone copy must not outlive the write.
+        Z_Free (texturecomposite[i]);
+    }
+
+    if (fclose (file) || !ok)
+        remove (TEXCACHENAME);
+}
+
+
+
 //
 // R_GetColumn
 //
@@ -438,6 +700,8 @@ void R_InitTextures (void)
     int                 temp2;
     int                 temp3;
 
+    unsigned            key;
+    boolean             usecache;
 
     // Load the patch names from pnames.lmp.
     name[8] = 0;
@@ -558,9 +822,22 @@ void R_InitTextures (void)
     if (maptex2)
         Z_Free (maptex2);
 
-    // Precalculate whatever possible.
-    for (i=0 ; i<numtextures ; i++)
-        R_GenerateLookup (i);
+    // Precalculate whatever possible, or load
+    //  it all from the texture cache.
+    key = R_TextureCacheKey ();
+    usecache = !M_CheckParm ("-notexcache");
+
+    if (!usecache || !R_LoadTextureCache (key))
+    {
+        for (i=0 ; i<numtextures ; i++)
+            R_GenerateLookup (i);
+
+        if (usecache)
+        {
+            R_WriteTextureCache (key);
+            R_LoadTextureCache (key);
+        }
+    }
 
     // Create translation table for global animation.
     texturetranslation = Z_Malloc ((numtextures+1)*4, PU_STATIC, 0);
@@ -730,62 +1007,104 @@ int     R_TextureNumForName (char* name)
 
 //
 // R_PrecacheLevel
-// Preloads all relevant graphics for the level.
+// Queues all relevant graphics for the level, nearest
+//  sectors first, for R_PrefetchLumps to load a slice
+//  at a time during the wipe and in idle time.
 //
 int             flatmemory;
 int             texturememory;
 int             spritememory;
 
-void R_PrecacheLevel (void)
+// Lump numbers, or -1-texture for a composite.
+static int*     prefetchqueue;
+static int      numprefetch;
+static int      prefetchpos;
+
+static byte*    prefetched;     // [numlumps+numtextures]
+
+static fixed_t* sectordist;
+
+
+static void R_QueueLump (int lump, int* memory)
 {
-    char*               flatpresent;
-    char*               texturepresent;
-    char*               spritepresent;
+    if (prefetched[lump])
+        return;
 
-    int                 i;
-    int                 j;
-    int                 k;
-    int                 lump;
+    prefetched[lump] = 1;
+    prefetchqueue[numprefetch++] = lump;
+    *memory += lumpinfo[lump].size;
+}
 
-    texture_t*          texture;
-    thinker_t*          th;
-    spriteframe_t*      sf;
 
-    if (demoplayback)
+static void R_QueueTexture (int tex)
+{
+    texture_t*  texture;
+    int         j;
+
+    if (prefetched[numlumps+tex])
         return;
 
-    // Precache flats.
-    flatpresent = alloca(numflats);
-    memset (flatpresent,0,numflats);
+    prefetched[numlumps+tex] = 1;
+    texture = textures[tex];
 
-    for (i=0 ; i<numsectors ; i++)
-    {
-        flatpresent[sectors[i].floorpic] = 1;
-        flatpresent[sectors[i].ceilingpic] = 1;
-    }
+    for (j=0 ; j<texture->patchcount ; j++)
+        R_QueueLump (texture->patches[j].patch, &texturememory);
 
-    flatmemory = 0;
+    if (texturecompositesize[tex])
+        prefetchqueue[numprefetch++] = -1-tex;
+}
 
-    for (i=0 ; i<numflats ; i++)
+
+static void R_QueueSprite (int sprite)
+{
+    spriteframe_t*      sf;
+    int                 j;
+    int                 k;
+
+    for (j=0 ; j<sprites[sprite].numframes ; j++)
     {
-        if (flatpresent[i])
-        {
-            lump = firstflat + i;
-            flatmemory += lumpinfo[lump].size;
-            W_CacheLumpNum(lump, PU_CACHE);
-        }
+        sf = &sprites[sprite].spriteframes[j];
+        for (k=0 ; k<8 ; k++)
+            R_QueueLump (firstspritelump + sf->lump[k], &spritememory);
     }
+}
+
+
+static int R_CompareSectorDist (const void* a, const void* b)
+{
+    return sectordist[*(int *)a] - sectordist[*(int *)b];
+}
+
+
+void R_PrecacheLevel (void)
+{
+    int                 i;
+    int                 j;
+    int                 k;
+    int*                order;
+
+    sector_t*           sector;
+    line_t*             line;
+    side_t*             side;
+    mobj_t*             mo;
+    mobj_t*             thing;
 
-    // Precache textures.
-    texturepresent = alloca(numtextures);
-    memset (texturepresent,0, numtextures);
+    // the timing of timedemos is kept as it was
+    if (timingdemo)
+        return;
 
-    for (i=0 ; i<numsides ; i++)
+    if (!prefetchqueue)
     {
-        texturepresent[sides[i].toptexture] = 1;
-        texturepresent[sides[i].midtexture] = 1;
-        texturepresent[sides[i].bottomtexture] = 1;
+        prefetchqueue = Z_Malloc ((numlumps+numtextures)*sizeof(int),
+                                  PU_STATIC, 0);
+        prefetched = Z_Malloc (numlumps+numtextures, PU_STATIC, 0);
     }
+    memset (prefetched, 0, numlumps+numtextures);
+    numprefetch = prefetchpos = 0;
+
+    flatmemory = 0;
+    texturememory = 0;
+    spritememory = 0;
 
     // Sky texture is always present.
     // Note that F_SKY1 is the name used to
@@ -793,53 +1112,83 @@ void R_PrecacheLevel (void)
     //  while the sky texture is stored like
     //  a wall texture, with an episode dependend
     //  name.
-    texturepresent[skytexture] = 1;
+    R_QueueTexture (skytexture);
 
-    texturememory = 0;
-    for (i=0 ; i<numtextures ; i++)
-    {
-        if (!texturepresent[i])
-            continue;
-
-        texture = textures[i];
+    // Sectors by distance from the console player.
+    order = alloca (numsectors*sizeof(*order));
+    sectordist = alloca (numsectors*sizeof(*sectordist));
+    mo = players[consoleplayer].mo;
 
-        for (j=0 ; j<texture->patchcount ; j++)
+    for (i=0 ; i<numsectors ; i++)
+    {
+        order[i] = i;
+        if (mo)
         {
-            lump = texture->patches[j].patch;
-            texturememory += lumpinfo[lump].size;
-            W_CacheLumpNum(lump , PU_CACHE);
+            sectordist[i] = P_AproxDistance (sectors[i].soundorg.x - mo->x,
+                                             sectors[i].soundorg.y - mo->y)
+                >> FRACBITS;
         }
+        else
+            sectordist[i] = 0;
     }
+    qsort (order, numsectors, sizeof(*order), R_CompareSectorDist);
 
-    // Precache sprites.
-    spritepresent = alloca(numsprites);
-    memset (spritepresent,0, numsprites);
-
-    for (th = thinkercap.next ; th != &thinkercap ; th=th->next)
+    // Flats, wall textures and sprites of each sector in turn.
+    for (i=0 ; i<numsectors ; i++)
     {
-        if (th->function.acp1 == (actionf_p1)P_MobjThinker)
-            spritepresent[((mobj_t *)th)->sprite] = 1;
-    }
+        sector = &sectors[order[i]];
 
-    spritememory = 0;
-    for (i=0 ; i<numsprites ; i++)
-    {
-        if (!spritepresent[i])
-            continue;
+        R_QueueLump (firstflat + sector->floorpic, &flatmemory);
+        R_QueueLump (firstflat + sector->ceilingpic, &flatmemory);
 
-        for (j=0 ; j<sprites[i].numframes ; j++)
+        // the side facing the sector, or both
+        //  when a line has it on either side
+        for (j=0 ; j<sector->linecount ; j++)
         {
-            sf = &sprites[i].spriteframes[j];
-            for (k=0 ; k<8 ; k++)
+            line = sector->lines[j];
+
+            for (k=0 ; k<2 ; k++)
             {
-                lump = firstspritelump + sf->lump[k];
-                spritememory += lumpinfo[lump].size;
-                W_CacheLumpNum(lump , PU_CACHE);
+                if (line->sidenum[k] == -1
+                    || (k ? line->backsector : line->frontsector) != sector)
+                    continue;
+
+                side = &sides[line->sidenum[k]];
+                R_QueueTexture (side->toptexture);
+                R_QueueTexture (side->midtexture);
+                R_QueueTexture (side->bottomtexture);
             }
         }
+
+        for (thing = sector->thinglist ; thing ; thing = thing->snext)
+            R_QueueSprite (thing->sprite);
     }
 }
 
 
+//
+// R_PrefetchLumps
+// Loads queued graphics until the given number
+//  of microseconds is used, at least one each call.
+//
+void R_PrefetchLumps (int us)
+{
+    int         start;
+    int         entry;
 
+    if (prefetchpos == numprefetch)
+        return;
+
+    start = I_GetTimeUS ();
+    do
+    {
+        entry = prefetchqueue[prefetchpos++];
 
+        if (entry >= 0)
+            W_CacheLumpNum (entry, PU_CACHE);
+        else if (!texturecomposite[-1-entry])
+            R_GenerateComposite (-1-entry);
+
+    } while (prefetchpos < numprefetch
+             && I_GetTimeUS () - start < us);
+}
@@ -43,6 +43,11 @@ R_GetColumn
 void R_InitData (void);
 void R_PrecacheLevel (void);
 
+// Time slice for R_PrefetchLumps once a frame.
+#define PREFETCHUS      1000
+
+void R_PrefetchLumps (int us);
+
 
 // Retrieval.
 // Floor/ceiling opaque texture tiles,
@@ -53,8 +53,6 @@
 #define SIL_TOP                 2
 #define SIL_BOTH                3
 
-#define MAXDRAWSEGS             256
-
 
 
 
@@ -208,9 +206,6 @@ typedef struct line_s
     sector_t*   frontsector;
     sector_t*   backsector;
 
-    // if == validcount, already checked
-    int         validcount;
-
     // thinker_t for reversable actions
     void*       specialdata;
 } line_t;
@@ -458,7 +453,7 @@ typedef struct
 //
 // Now what is a visplane, anyway?
 //
-typedef struct
+typedef struct visplane_s
 {
   fixed_t               height;
   int                   picnum;
@@ -466,6 +461,9 @@ typedef struct
   int                   minx;
   int                   maxx;
 
+  // next in R_FindPlane hash chain
+  struct visplane_s*    next;
+
   // leave pads for [minx-1]/[maxx+1]
 
   byte          pad1;
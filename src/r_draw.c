@@ -28,6 +28,8 @@ static const char __attribute__((unused))
 rcsid[] = "$Id: r_draw.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 
 
+#include <stdint.h>
+
 #include "doomdef.h"
 
 #include "i_system.h"
@@ -58,6 +60,24 @@ rcsid[] = "$Id: r_draw.c,v 1.4 1997/02/03 16:47:55 b1 Exp $";
 //  and we need only the base address,
 //  and the total size == width*height*depth/8.,
 //
+// Built with COLMAJOR, the view is drawn transposed into
+//  viewbuffer instead, each column a SCREENHEIGHT run of
+//  bytes, so the column drawers write sequential memory.
+//  R_FlushView copies it to the view window of screens[0]
+//  once the view is complete.
+//
+#ifdef COLMAJOR
+#define VIEWPIXEL(x,y)  (viewbuffer + (x)*SCREENHEIGHT + (y))
+#define COLSTEP         1
+#define SPANSTEP        SCREENHEIGHT
+#else
+#define VIEWPIXEL(x,y)  (screens[0] + (viewwindowy+(y))*SCREENWIDTH \
+                         + viewwindowx+(x))
+#define COLSTEP         SCREENWIDTH
+#define SPANSTEP        1
+#endif
+
+byte*           viewbuffer;
 
 
 byte*           viewimage;
@@ -121,7 +141,7 @@ void R_DrawColumn (void)
 #endif
 
     // Framebuffer destination address.
-    dest = screens[0] + (viewwindowy + dc_yl) * SCREENWIDTH + (viewwindowx + dc_x);
+    dest = VIEWPIXEL(dc_x, dc_yl);
 
     // Determine scaling,
     //  which is the only mapping to be done.
@@ -137,7 +157,7 @@ void R_DrawColumn (void)
         //  using a lighting/special effects LUT.
         *dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
 
-        dest += SCREENWIDTH;
+        dest += COLSTEP;
         frac += fracstep;
 
     } while (count--);
@@ -172,8 +192,8 @@ void R_DrawColumnLow (void)
     // Blocky mode, need to multiply by 2.
     dc_x <<= 1;
 
-    dest = screens[0] + (viewwindowy + dc_yl) * SCREENWIDTH + (viewwindowx + dc_x);
-    dest2 = dest + 1;
+    dest = VIEWPIXEL(dc_x, dc_yl);
+    dest2 = VIEWPIXEL(dc_x+1, dc_yl);
 
     fracstep = dc_iscale;
     frac = dc_texturemid + (dc_yl-centery)*fracstep;
@@ -182,8 +202,8 @@ void R_DrawColumnLow (void)
     {
         // Hack. Does not work corretly.
         *dest2 = *dest = dc_colormap[dc_source[(frac>>FRACBITS)&127]];
-        dest += SCREENWIDTH;
-        dest2 += SCREENWIDTH;
+        dest += COLSTEP;
+        dest2 += COLSTEP;
         frac += fracstep;
 
     } while (count--);
@@ -194,7 +214,7 @@ void R_DrawColumnLow (void)
 // Spectre/Invisibility.
 //
 #define FUZZTABLE               50
-#define FUZZOFF (SCREENWIDTH)
+#define FUZZOFF (COLSTEP)
 
 
 int     fuzzoffset[FUZZTABLE] =
@@ -277,7 +297,7 @@ void R_DrawFuzzColumn (void)
 
 
     // Does not work with blocky mode.
-    dest = screens[0] + (viewwindowy + dc_yl) * SCREENWIDTH + (viewwindowx + dc_x);
+    dest = VIEWPIXEL(dc_x, dc_yl);
 
     // Looks familiar.
     fracstep = dc_iscale;
@@ -298,7 +318,7 @@ void R_DrawFuzzColumn (void)
         if (++fuzzpos == FUZZTABLE)
             fuzzpos = 0;
 
-        dest += SCREENWIDTH;
+        dest += COLSTEP;
 
         frac += fracstep;
     } while (count--);
@@ -362,7 +382,7 @@ void R_DrawTranslatedColumn (void)
 
 
     // FIXME. As above.
-    dest = screens[0] + (viewwindowy + dc_yl) * SCREENWIDTH + (viewwindowx + dc_x);
+    dest = VIEWPIXEL(dc_x, dc_yl);
 
     // Looks familiar.
     fracstep = dc_iscale;
@@ -377,7 +397,7 @@ void R_DrawTranslatedColumn (void)
         // Thus the "green" ramp of the player 0 sprite
         //  is mapped to gray, red, black/indigo.
         *dest = dc_colormap[dc_translation[dc_source[frac>>FRACBITS]]];
-        dest += SCREENWIDTH;
+        dest += COLSTEP;
 
         frac += fracstep;
     } while (count--);
@@ -398,7 +418,7 @@ void R_InitTranslationTables (void)
     int         i;
 
     translationtables = Z_Malloc (256*3+255, PU_STATIC, 0);
-    translationtables = (byte *)(( (int)translationtables + 255 )& ~255);
+    translationtables = (byte *)(( (uintptr_t)translationtables + 255 )& ~255);
 
     // translate just the 16 green colors
     for (i=0 ; i<256 ; i++)
@@ -478,7 +498,7 @@ void R_DrawSpan (void)
     xfrac = ds_xfrac;
     yfrac = ds_yfrac;
 
-    dest = screens[0] + (viewwindowy + ds_y) * SCREENWIDTH + (viewwindowx + ds_x1);
+    dest = VIEWPIXEL(ds_x1, ds_y);
 
     // We do not check for zero spans here?
     count = ds_x2 - ds_x1;
@@ -490,7 +510,8 @@ void R_DrawSpan (void)
 
         // Lookup pixel from flat texture tile,
         //  re-index using light/colormap.
-        *dest++ = ds_colormap[ds_source[spot]];
+        *dest = ds_colormap[ds_source[spot]];
+        dest += SPANSTEP;
 
         // Next step in u,v.
         xfrac += ds_xstep;
@@ -531,7 +552,7 @@ void R_DrawSpanLow (void)
     ds_x1 <<= 1;
     ds_x2 <<= 1;
 
-    dest = screens[0] + (viewwindowy + ds_y) * SCREENWIDTH + (viewwindowx + ds_x1);
+    dest = VIEWPIXEL(ds_x1, ds_y);
 
 
     count = ds_x2 - ds_x1;
@@ -540,8 +561,10 @@ void R_DrawSpanLow (void)
         spot = ((yfrac>>(16-6))&(63*64)) + ((xfrac>>16)&63);
         // Lowres/blocky mode does it twice,
         //  while scale is adjusted appropriately.
-        *dest++ = ds_colormap[ds_source[spot]];
-        *dest++ = ds_colormap[ds_source[spot]];
+        *dest = ds_colormap[ds_source[spot]];
+        dest += SPANSTEP;
+        *dest = ds_colormap[ds_source[spot]];
+        dest += SPANSTEP;
 
         xfrac += ds_xstep;
         yfrac += ds_ystep;
@@ -549,6 +572,193 @@ void R_DrawSpanLow (void)
     } while (count--);
 }
 
+
+
+#ifndef COLMAJOR
+//
+// Packed span drawers, picked with -packedspans.
+// Where the view is row-major, spans can be drawn a word
+//  at a time: byte stores up to a 4 byte boundary, then
+//  four texels packed into each 32 bit store, then the tail.
+// Output matches the byte drawers (linux/spantest checks
+//  it and times both). They are not the default: on the
+//  host they lose on short spans and win on long ones,
+//  and they have not been timed on the target yet.
+//
+#define SPANTEXEL(xf,yf) \
+    ds_colormap[ds_source[(((yf)>>(16-6))&(63*64)) + (((xf)>>16)&63)]]
+
+#ifdef __BIG_ENDIAN__
+#define PACK4(a,b,c,d)  (((a)<<24) | ((b)<<16) | ((c)<<8) | (d))
+#else
+#define PACK4(a,b,c,d)  ((a) | ((b)<<8) | ((c)<<16) | ((d)<<24))
+#endif
+
+
+//
+// R_DrawSpanPacked
+//
+void R_DrawSpanPacked (void)
+{
+    fixed_t             xfrac;
+    fixed_t             yfrac;
+    fixed_t             xstep;
+    fixed_t             ystep;
+    byte*               dest;
+    int                 count;
+    unsigned            p0, p1, p2, p3;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+        || ds_x1<0
+        || ds_x2>=SCREENWIDTH
+        || (unsigned)ds_y>SCREENHEIGHT)
+    {
+        I_Error( "R_DrawSpan: %i to %i at %i",
+                 ds_x1,ds_x2,ds_y);
+    }
+//      dscount++;
+#endif
+
+
+    xfrac = ds_xfrac;
+    yfrac = ds_yfrac;
+    xstep = ds_xstep;
+    ystep = ds_ystep;
+
+    dest = VIEWPIXEL(ds_x1, ds_y);
+
+    // We do not check for zero spans here?
+    count = ds_x2 - ds_x1 + 1;
+
+    while (count && ((unsigned long)dest & 3))
+    {
+        *dest++ = SPANTEXEL(xfrac, yfrac);
+        xfrac += xstep;
+        yfrac += ystep;
+        count--;
+    }
+
+    while (count >= 4)
+    {
+        p0 = SPANTEXEL(xfrac, yfrac);
+        xfrac += xstep;
+        yfrac += ystep;
+        p1 = SPANTEXEL(xfrac, yfrac);
+        xfrac += xstep;
+        yfrac += ystep;
+        p2 = SPANTEXEL(xfrac, yfrac);
+        xfrac += xstep;
+        yfrac += ystep;
+        p3 = SPANTEXEL(xfrac, yfrac);
+        xfrac += xstep;
+        yfrac += ystep;
+
+        *(unsigned *)dest = PACK4(p0, p1, p2, p3);
+        dest += 4;
+        count -= 4;
+    }
+
+    while (count--)
+    {
+        // Lookup pixel from flat texture tile,
+        //  re-index using light/colormap.
+        *dest = SPANTEXEL(xfrac, yfrac);
+        dest++;
+
+        // Next step in u,v.
+        xfrac += xstep;
+        yfrac += ystep;
+    }
+}
+
+
+
+//
+// R_DrawSpanLowPacked
+// Every texel covers two pixels, so a word holds two texels.
+//
+void R_DrawSpanLowPacked (void)
+{
+    fixed_t             xfrac;
+    fixed_t             yfrac;
+    fixed_t             xstep;
+    fixed_t             ystep;
+    byte*               dest;
+    int                 count;
+    unsigned            p0;
+    unsigned            p1;
+
+#ifdef RANGECHECK
+    if (ds_x2 < ds_x1
+        || ds_x1<0
+        || ds_x2>=SCREENWIDTH
+        || (unsigned)ds_y>SCREENHEIGHT)
+    {
+        I_Error( "R_DrawSpan: %i to %i at %i",
+                 ds_x1,ds_x2,ds_y);
+    }
+//      dscount++;
+#endif
+
+    xfrac = ds_xfrac;
+    yfrac = ds_yfrac;
+    xstep = ds_xstep;
+    ystep = ds_ystep;
+
+    // Blocky mode, need to multiply by 2.
+    ds_x1 <<= 1;
+    ds_x2 <<= 1;
+
+    dest = VIEWPIXEL(ds_x1, ds_y);
+
+    // Texels to draw.
+    count = ds_x2 - ds_x1 + 1;
+
+    // An odd address never lines a pair up with a word.
+    if (!((unsigned long)dest & 1))
+    {
+        if (count && ((unsigned long)dest & 2))
+        {
+            p0 = SPANTEXEL(xfrac, yfrac);
+            dest[0] = dest[1] = p0;
+            dest += 2;
+            xfrac += xstep;
+            yfrac += ystep;
+            count--;
+        }
+
+        while (count >= 2)
+        {
+            p0 = SPANTEXEL(xfrac, yfrac);
+            xfrac += xstep;
+            yfrac += ystep;
+            p1 = SPANTEXEL(xfrac, yfrac);
+            xfrac += xstep;
+            yfrac += ystep;
+
+            *(unsigned *)dest = PACK4(p0, p0, p1, p1);
+            dest += 4;
+            count -= 2;
+        }
+    }
+
+    while (count--)
+    {
+        // Lowres/blocky mode does it twice,
+        //  while scale is adjusted appropriately.
+        p0 = SPANTEXEL(xfrac, yfrac);
+        *dest = p0;
+        dest++;
+        *dest = p0;
+        dest++;
+
+        xfrac += xstep;
+        yfrac += ystep;
+    }
+}
+#endif
+
 //
 // R_InitBuffer
 // Creats lookup tables that avoid
@@ -571,6 +781,43 @@ R_InitBuffer
         viewwindowy = 0;
     else
         viewwindowy = (SCREENHEIGHT-SBARHEIGHT-height) >> 1;
+
+#ifdef COLMAJOR
+    if (!viewbuffer)
+        viewbuffer = Z_Malloc (SCREENWIDTH*SCREENHEIGHT, PU_STATIC, NULL);
+#endif
+}
+
+
+
+//
+// R_FlushView
+// Copies a transposed (COLMAJOR) view into screens[0],
+//  eight columns at a time so both sides stream.
+//
+void R_FlushView (void)
+{
+#ifdef COLMAJOR
+    byte*       dest;
+    byte*       src;
+    int         x;
+    int         x2;
+    int         y;
+    int         i;
+
+    for (x=0 ; x<scaledviewwidth ; x+=8)
+    {
+        x2 = x+8 < scaledviewwidth ? x+8 : scaledviewwidth;
+        dest = screens[0] + viewwindowy*SCREENWIDTH + viewwindowx;
+        src = viewbuffer;
+
+        for (y=0 ; y<viewheight ; y++, dest+=SCREENWIDTH, src++)
+        {
+            for (i=x ; i<x2 ; i++)
+                dest[i] = src[i*SCREENHEIGHT];
+        }
+    }
+#endif
 }
 
 
@@ -87,12 +87,21 @@ void    R_DrawSpan (void);
 // Low resolution mode, 160x200?
 void    R_DrawSpanLow (void);
 
+#ifndef COLMAJOR
+// Same output with 32 bit stores, -packedspans.
+void    R_DrawSpanPacked (void);
+void    R_DrawSpanLowPacked (void);
+#endif
+
 
 void
 R_InitBuffer
 ( int           width,
   int           height );
 
+// Copies a column-major view to screens[0]; no-op otherwise.
+void    R_FlushView (void);
+
 
 // Initialize color translation tables,
 //  for player rendering etc.
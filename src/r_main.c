@@ -29,13 +29,17 @@ rcsid[] = "$Id: r_main.c,v 1.5 1997/02/03 22:45:12 b1 Exp $";
 
 
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 
 #include "doomdef.h"
 #include "d_net.h"
 
+#include "m_argv.h"
 #include "m_bbox.h"
+#include "m_bench.h"
+#include "z_zone.h"
 
 #include "r_local.h"
 #include "r_sky.h"
@@ -54,6 +58,8 @@ int                     viewangleoffset;
 // increment every time a check is made
 int                     validcount = 1;
 
+renderpeaks_t           renderpeaks;
+
 
 lighttable_t*           fixedcolormap;
 extern lighttable_t**   walllights;
@@ -714,6 +720,12 @@ void R_ExecuteSetViewSize (void)
         spanfunc = R_DrawSpanLow;
     }
 
+#ifndef COLMAJOR
+    // opt in until they are measured to help on the target
+    if (M_CheckParm ("-packedspans"))
+        spanfunc = detailshift ? R_DrawSpanLowPacked : R_DrawSpanPacked;
+#endif
+
     R_InitBuffer (scaledviewwidth, viewheight);
 
     R_InitTextureMapping ();
@@ -864,6 +876,32 @@ void R_SetupFrame (player_t* player)
 
 
 
+//
+// R_UpdatePeaks
+// Pool usage telemetry, at the end of a frame.
+//
+void R_UpdatePeaks (void)
+{
+    int         count;
+
+    if (numvisplanes > renderpeaks.visplanes)
+        renderpeaks.visplanes = numvisplanes;
+
+    count = R_OpeningsUsed ();
+    if (count > renderpeaks.openings)
+        renderpeaks.openings = count;
+
+    count = ds_p - drawsegs;
+    if (count > renderpeaks.drawsegs)
+        renderpeaks.drawsegs = count;
+
+    count = vissprite_p - vissprites;
+    if (count > renderpeaks.vissprites)
+        renderpeaks.vissprites = count;
+}
+
+
+
 //
 // R_RenderView
 //
@@ -881,17 +919,29 @@ void R_RenderPlayerView (player_t* player)
     NetUpdate ();
 
     // The head node is the last node output.
+    M_BenchBegin (bench_bsp);
     R_RenderBSPNode (numnodes-1);
+    M_BenchEnd (bench_bsp);
 
     // Check for new console commands.
     NetUpdate ();
 
+    M_BenchBegin (bench_planes);
     R_DrawPlanes ();
+    M_BenchEnd (bench_planes);
 
     // Check for new console commands.
     NetUpdate ();
 
+    M_BenchBegin (bench_masked);
     R_DrawMasked ();
+    M_BenchEnd (bench_masked);
+
+    M_BenchBegin (bench_flush);
+    R_FlushView ();
+    M_BenchEnd (bench_flush);
+
+    R_UpdatePeaks ();
 
     // Check for new console commands.
     NetUpdate ();
@@ -55,6 +55,23 @@ extern fixed_t          projection;
 
 extern int              validcount;
 
+
+//
+// Growable renderer pools (visplanes, openings, drawsegs,
+//  vissprites) live in the zone and keep their high-water
+//  size, the peaks seen in a single frame are kept here.
+//
+typedef struct
+{
+    int         visplanes;
+    int         openings;
+    int         drawsegs;
+    int         vissprites;
+
+} renderpeaks_t;
+
+extern renderpeaks_t    renderpeaks;
+
 extern int              linecount;
 extern int              loopcount;
 
@@ -50,15 +50,40 @@ planefunction_t         ceilingfunc;
 //
 
 // Here comes the obnoxious "visplane".
-#define MAXVISPLANES    128
-visplane_t              visplanes[MAXVISPLANES];
-visplane_t*             lastvisplane;
+// Planes are allocated in zone chunks that never move,
+//  so visplane pointers stay good when more planes
+//  are needed halfway through a frame.
+#define VISPLANECHUNK   32
+visplane_t**            visplanes;
+int                     numvisplanes;
+int                     maxvisplanes;
 visplane_t*             floorplane;
 visplane_t*             ceilingplane;
 
-// ?
-#define MAXOPENINGS     SCREENWIDTH*64
-short                   openings[MAXOPENINGS];
+// R_FindPlane hash.
+// Only the first plane made for a height/picnum/lightlevel
+//  goes in, R_CheckPlane splits never do, so lookups give
+//  the same plane the old linear scan did.
+#define VISPLANEHASHSIZE        128
+// Heights are whole units in practice, hence the shift.
+#define VISPLANEHASH(h,p,l) \
+    ((unsigned)((p)*3 + (l) + ((h)>>FRACBITS)*7) & (VISPLANEHASHSIZE-1))
+
+visplane_t*             visplanehash[VISPLANEHASHSIZE];
+
+// Openings come in chunks as well, drawsegs point into them.
+#define OPENINGCHUNK    (SCREENWIDTH*16)
+
+typedef struct openings_s
+{
+    struct openings_s*  next;
+    short               data[OPENINGCHUNK];
+
+} openings_t;
+
+openings_t*             openings;
+openings_t*             curopenings;
+int                     openingsused;   // in chunks before curopenings
 short*                  lastopening;
 
 
@@ -101,7 +126,65 @@ fixed_t                 cachedystep[SCREENHEIGHT];
 //
 void R_InitPlanes (void)
 {
-  // Doh!
+    openings = Z_Malloc (sizeof(*openings), PU_STATIC, NULL);
+    openings->next = NULL;
+}
+
+
+//
+// R_NewVisPlane
+//
+visplane_t* R_NewVisPlane (void)
+{
+    visplane_t* chunk;
+    int         i;
+
+    if (numvisplanes == maxvisplanes)
+    {
+        visplanes = Z_GrowArray (visplanes, maxvisplanes,
+                                 maxvisplanes+VISPLANECHUNK,
+                                 sizeof(*visplanes));
+
+        chunk = Z_Malloc (VISPLANECHUNK*sizeof(*chunk), PU_STATIC, NULL);
+
+        for (i=0 ; i<VISPLANECHUNK ; i++)
+            visplanes[maxvisplanes+i] = &chunk[i];
+
+        maxvisplanes += VISPLANECHUNK;
+    }
+
+    return visplanes[numvisplanes++];
+}
+
+
+//
+// R_CheckOpenings
+// Makes sure count openings can be taken from lastopening.
+//
+void R_CheckOpenings (int count)
+{
+    if (lastopening + count <= curopenings->data + OPENINGCHUNK)
+        return;
+
+    openingsused += lastopening - curopenings->data;
+
+    if (!curopenings->next)
+    {
+        curopenings->next = Z_Malloc (sizeof(*openings), PU_STATIC, NULL);
+        curopenings->next->next = NULL;
+    }
+
+    curopenings = curopenings->next;
+    lastopening = curopenings->data;
+}
+
+
+//
+// R_OpeningsUsed
+//
+int R_OpeningsUsed (void)
+{
+    return openingsused + (lastopening - curopenings->data);
 }
 
 
@@ -187,6 +270,7 @@ void R_ClearPlanes (void)
 {
     int         i;
     angle_t     angle;
+    visplane_t* pl;
 
     // opening / clipping determination
     for (i=0 ; i<viewwidth ; i++)
@@ -195,8 +279,18 @@ void R_ClearPlanes (void)
         ceilingclip[i] = -1;
     }
 
-    lastvisplane = visplanes;
-    lastopening = openings;
+    // only empty the chains that were used
+    for (i=0 ; i<numvisplanes ; i++)
+    {
+        pl = visplanes[i];
+        visplanehash[VISPLANEHASH(pl->height, pl->picnum, pl->lightlevel)]
+            = NULL;
+    }
+
+    numvisplanes = 0;
+    curopenings = openings;
+    openingsused = 0;
+    lastopening = openings->data;
 
     // texture calculation
     memset (cachedheight, 0, sizeof(cachedheight));
@@ -222,6 +316,7 @@ R_FindPlane
   int           lightlevel )
 {
     visplane_t* check;
+    unsigned    hash;
 
     if (picnum == skyflatnum)
     {
@@ -229,24 +324,21 @@ R_FindPlane
         lightlevel = 0;
     }
 
-    for (check=visplanes; check<lastvisplane; check++)
+    hash = VISPLANEHASH(height, picnum, lightlevel);
+
+    for (check=visplanehash[hash] ; check ; check=check->next)
     {
         if (height == check->height
             && picnum == check->picnum
             && lightlevel == check->lightlevel)
         {
-            break;
+            return check;
         }
     }
 
-
-    if (check < lastvisplane)
-        return check;
-
-    if (lastvisplane - visplanes == MAXVISPLANES)
-        I_Error ("R_FindPlane: no more visplanes");
-
-    lastvisplane++;
+    check = R_NewVisPlane ();
+    check->next = visplanehash[hash];
+    visplanehash[hash] = check;
 
     check->height = height;
     check->picnum = picnum;
@@ -274,6 +366,7 @@ R_CheckPlane
     int         unionl;
     int         unionh;
     int         x;
+    visplane_t* newpl;
 
     if (start < pl->minx)
     {
@@ -310,12 +403,14 @@ R_CheckPlane
         return pl;
     }
 
-    // make a new visplane
-    lastvisplane->height = pl->height;
-    lastvisplane->picnum = pl->picnum;
-    lastvisplane->lightlevel = pl->lightlevel;
+    // make a new visplane,
+    //  kept out of the R_FindPlane hash
+    newpl = R_NewVisPlane ();
+    newpl->height = pl->height;
+    newpl->picnum = pl->picnum;
+    newpl->lightlevel = pl->lightlevel;
 
-    pl = lastvisplane++;
+    pl = newpl;
     pl->minx = start;
     pl->maxx = stop;
 
@@ -368,27 +463,16 @@ R_MakeSpans
 void R_DrawPlanes (void)
 {
     visplane_t*         pl;
+    int                 i;
     int                 light;
     int                 x;
     int                 stop;
     int                 angle;
 
-#ifdef RANGECHECK
-    if (ds_p - drawsegs > MAXDRAWSEGS)
-        I_Error ("R_DrawPlanes: drawsegs overflow (%i)",
-                 ds_p - drawsegs);
-
-    if (lastvisplane - visplanes > MAXVISPLANES)
-        I_Error ("R_DrawPlanes: visplane overflow (%i)",
-                 lastvisplane - visplanes);
-
-    if (lastopening - openings > MAXOPENINGS)
-        I_Error ("R_DrawPlanes: opening overflow (%i)",
-                 lastopening - openings);
-#endif
-
-    for (pl = visplanes ; pl < lastvisplane ; pl++)
+    for (i=0 ; i<numvisplanes ; i++)
     {
+        pl = visplanes[i];
+
         if (pl->minx > pl->maxx)
             continue;
 
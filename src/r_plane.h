@@ -35,6 +35,9 @@
 // Visplane related.
 extern  short*          lastopening;
 
+extern  visplane_t**    visplanes;
+extern  int             numvisplanes;
+
 
 typedef void (*planefunction_t) (int top, int bottom);
 
@@ -50,6 +53,10 @@ extern fixed_t          distscale[SCREENWIDTH];
 void R_InitPlanes (void);
 void R_ClearPlanes (void);
 
+visplane_t* R_NewVisPlane (void);
+void R_CheckOpenings (int count);
+int R_OpeningsUsed (void);
+
 void
 R_MapPlane
 ( int           y,
@@ -379,9 +379,10 @@ R_StoreWallRange
     fixed_t             vtop;
     int                 lightnum;
 
-    // don't overflow and crash
-    if (ds_p == &drawsegs[MAXDRAWSEGS])
-        return;
+    // room for the drawseg, its masked texture
+    //  columns and both sprite clip arrays
+    R_CheckDrawSegs ();
+    R_CheckOpenings (3*(stop-start+1));
 
 #ifdef RANGECHECK
     if (start >=viewwidth || start > stop)
@@ -94,6 +94,10 @@ extern node_t*          nodes;
 extern int              numlines;
 extern line_t*          lines;
 
+// Per line: if == validcount, already checked.
+// Kept out of line_t so queries don't write to the lines.
+extern int*             linevalidcount;
+
 extern int              numsides;
 extern side_t*          sides;
 
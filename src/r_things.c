@@ -34,6 +34,7 @@ rcsid[] = "$Id: r_things.c,v 1.5 1997/02/03 16:47:56 b1 Exp $";
 #include "m_swap.h"
 
 #include "i_system.h"
+#include "m_bench.h"
 #include "z_zone.h"
 #include "w_wad.h"
 
@@ -286,10 +287,14 @@ void R_InitSpriteDefs (char** namelist)
 //
 // GAME FUNCTIONS
 //
-vissprite_t     vissprites[MAXVISSPRITES];
+vissprite_t*    vissprites;
 vissprite_t*    vissprite_p;
+int             maxvissprites;
 int             newvissprite;
 
+// merge sort buffers, as big as vissprites
+static vissprite_t**    vsprsort[2];
+
 
 
 //
@@ -323,12 +328,26 @@ void R_ClearSprites (void)
 //
 // R_NewVisSprite
 //
-vissprite_t     overflowsprite;
-
 vissprite_t* R_NewVisSprite (void)
 {
-    if (vissprite_p == &vissprites[MAXVISSPRITES])
-        return &overflowsprite;
+    int         count;
+    int         newmax;
+
+    if (vissprite_p == vissprites+maxvissprites)
+    {
+        count = vissprite_p - vissprites;
+        newmax = maxvissprites ? maxvissprites*2 : 64;
+
+        vissprites = Z_GrowArray (vissprites, count,
+                                  newmax, sizeof(*vissprites));
+        vsprsort[0] = Z_GrowArray (vsprsort[0], 0,
+                                   newmax, sizeof(*vsprsort[0]));
+        vsprsort[1] = Z_GrowArray (vsprsort[1], 0,
+                                   newmax, sizeof(*vsprsort[1]));
+
+        maxvissprites = newmax;
+        vissprite_p = vissprites + count;
+    }
 
     vissprite_p++;
     return vissprite_p-1;
@@ -786,51 +805,72 @@ vissprite_t     vsprsortedhead;
 
 void R_SortVisSprites (void)
 {
-    int                 i;
     int                 count;
+    int                 width;
+    int                 lo;
+    int                 mid;
+    int                 hi;
+    int                 i;
+    int                 j;
+    int                 k;
+    vissprite_t**       src;
+    vissprite_t**       dst;
+    vissprite_t**       swap;
     vissprite_t*        ds;
-    vissprite_t*        best;
-    vissprite_t         unsorted;
-    fixed_t             bestscale;
 
     count = vissprite_p - vissprites;
 
-    unsorted.next = unsorted.prev = &unsorted;
+    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
 
     if (!count)
         return;
 
-    for (ds=vissprites ; ds<vissprite_p ; ds++)
-    {
-        ds->next = ds+1;
-        ds->prev = ds-1;
-    }
+    for (i=0 ; i<count ; i++)
+        vsprsort[0][i] = &vissprites[i];
 
-    vissprites[0].prev = &unsorted;
-    unsorted.next = &vissprites[0];
-    (vissprite_p-1)->next = &unsorted;
-    unsorted.prev = vissprite_p-1;
+    // bottom up merge sort by scale.
+    // It is stable, so equal scales keep the
+    //  order the old selection sort gave them.
+    src = vsprsort[0];
+    dst = vsprsort[1];
 
-    // pull the vissprites out by scale
-    //best = 0;         // shut up the compiler warning
-    vsprsortedhead.next = vsprsortedhead.prev = &vsprsortedhead;
-    for (i=0 ; i<count ; i++)
+    for (width=1 ; width<count ; width<<=1)
     {
-        bestscale = MAXINT;
-        for (ds=unsorted.next ; ds!= &unsorted ; ds=ds->next)
+        for (lo=0 ; lo<count ; lo+=2*width)
         {
-            if (ds->scale < bestscale)
+            mid = lo+width < count ? lo+width : count;
+            hi = lo+2*width < count ? lo+2*width : count;
+
+            i = lo;
+            j = mid;
+            k = lo;
+
+            while (i < mid && j < hi)
             {
-                bestscale = ds->scale;
-                best = ds;
+                if (src[j]->scale < src[i]->scale)
+                    dst[k++] = src[j++];
+                else
+                    dst[k++] = src[i++];
             }
+            while (i < mid)
+                dst[k++] = src[i++];
+            while (j < hi)
+                dst[k++] = src[j++];
         }
-        best->next->prev = best->prev;
-        best->prev->next = best->next;
-        best->next = &vsprsortedhead;
-        best->prev = vsprsortedhead.prev;
-        vsprsortedhead.prev->next = best;
-        vsprsortedhead.prev = best;
+
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    // link them up back to front
+    for (i=0 ; i<count ; i++)
+    {
+        ds = src[i];
+        ds->next = &vsprsortedhead;
+        ds->prev = vsprsortedhead.prev;
+        vsprsortedhead.prev->next = ds;
+        vsprsortedhead.prev = ds;
     }
 }
 
@@ -960,7 +1000,10 @@ void R_DrawMasked (void)
     vissprite_t*        spr;
     drawseg_t*          ds;
 
+    M_BenchBegin (bench_sort);
     R_SortVisSprites ();
+    M_BenchEnd (bench_sort);
+    M_BenchSorted (vissprite_p - vissprites);
 
     if (vissprite_p > vissprites)
     {
@@ -29,9 +29,7 @@
 #pragma interface
 #endif
 
-#define MAXVISSPRITES   128
-
-extern vissprite_t      vissprites[MAXVISSPRITES];
+extern vissprite_t*     vissprites;
 extern vissprite_t*     vissprite_p;
 extern vissprite_t      vsprsortedhead;
 
@@ -61,6 +61,7 @@ rcsid[] = "$Id: d_main.c,v 1.8 1997/02/03 22:45:09 b1 Exp $";
 #include "m_argv.h"
 #include "m_misc.h"
 #include "m_menu.h"
+#include "m_bench.h"
 
 #include "i_system.h"
 #include "i_sound.h"
@@ -239,7 +240,9 @@ void D_Display (void)
             redrawsbar = true;
         if (inhelpscreensstate && !inhelpscreens)
             redrawsbar = true;              // just put away the help screen
+        M_BenchBegin (bench_status);
         ST_Drawer (viewheight == 200, redrawsbar );
+        M_BenchEnd (bench_status);
         fullscreen = viewheight == 200;
         break;
 
@@ -315,7 +318,9 @@ void D_Display (void)
     // normal update
     if (!wipe)
     {
+        M_BenchBegin (bench_blit);
         I_FinishUpdate ();              // page flip or blit buffer
+        M_BenchEnd (bench_blit);
         return;
     }
 
@@ -328,6 +333,8 @@ void D_Display (void)
     {
         do
         {
+            // the new level's graphics load while the wipe waits
+            R_PrefetchLumps (0);
             nowtime = I_GetTime ();
             tics = nowtime - wipestart;
         } while (!tics);
@@ -336,7 +343,9 @@ void D_Display (void)
                                , 0, 0, SCREENWIDTH, SCREENHEIGHT, tics);
         I_UpdateNoBlit ();
         M_Drawer ();                            // menu is drawn even on top of wipes
+        M_BenchBegin (bench_blit);
         I_FinishUpdate ();                      // page flip or blit buffer
+        M_BenchEnd (bench_blit);
     } while (!done);
 }
 
@@ -363,7 +372,9 @@ void D_DoomLoop (void)
             if (advancedemo)
                 D_DoAdvanceDemo ();
             M_Ticker ();
+            M_BenchBegin (bench_ticker);
             G_Ticker ();
+            M_BenchEnd (bench_ticker);
             gametic++;
             maketic++;
         }
@@ -374,6 +385,10 @@ void D_DoomLoop (void)
 
         // Update display, next frame, with current state.
         D_Display ();
+        M_BenchFrame ();
+
+        // a slice of whatever the level still has to load
+        R_PrefetchLumps (PREFETCHUS);
     }
 }
 
@@ -564,6 +579,8 @@ void IdentifyVersion (void)
 //
 void D_DoomMain (void)
 {
+    int             p;
+
     IdentifyVersion ();
 
     setbuf (stdout, NULL);
@@ -624,6 +641,15 @@ void D_DoomMain (void)
     printf ("ST_Init: Init status bar.\n");
     ST_Init ();
 
+    // -timedemo <lump> : play a demo as fast as possible
+    //  and print frame timings when it ends
+    p = M_CheckParm ("-timedemo");
+    if (p && p < myargc-1)
+    {
+        G_TimeDemo (myargv[p+1]);
+        D_DoomLoop ();  // never returns
+    }
+
     if ( gameaction != ga_loadgame )
     {
         if (autostart || netgame)
@@ -25,6 +25,10 @@
 #include <string.h>
 #include <time.h>
 #include <wchar.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 #include "../doomdef.h"
 #include "SDL_events.h"
@@ -47,6 +51,18 @@
 static uint16_t vt_last = 0;
 static uint32_t vt_base = 0;
 
+/* Event ring the host fills in place, see SDL_EVENT_RING */
+#define EVRINGSIZE MAXEVENTS
+
+typedef struct {
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    event_t events[EVRINGSIZE];
+} evring_t;
+
+static evring_t evring;
+static int evringactive;
+
 void I_Init(void) {
     // vt_last = video_state[0] & 0xffff;
 }
@@ -57,6 +73,31 @@ byte *I_ZoneBase(int *size) {
     return (byte *) malloc(*size);
 }
 
+byte *I_MapWadFile(int handle, int size) {
+#if defined(WAD_ROM_BASE)
+    /* WAD flashed at a fixed address (see prog_wad), check the
+     * header matches the file we were asked for before using it */
+    byte *rom = (byte *) (WAD_ROM_BASE);
+    byte header[12];
+
+    lseek(handle, 0, SEEK_SET);
+    if (read(handle, header, sizeof(header)) != sizeof(header))
+        return NULL;
+    if (memcmp(header, rom, sizeof(header)))
+        return NULL;
+    return rom;
+#elif defined(__linux__)
+    /* Private writable mapping, pages only get copied if touched */
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, handle, 0);
+
+    if (base == MAP_FAILED)
+        return NULL;
+    return (byte *) base;
+#else
+    return NULL;
+#endif
+}
+
 int I_GetTime(void) {
     struct timespec ts;
 
@@ -70,6 +111,15 @@ int I_GetTime(void) {
     return (vt_base + vt_now);
 }
 
+int I_GetTimeUS(void) {
+    /* Only used for benchmarking. clock() is the only time base the
+     * target has; the game never sleeps, so it tracks wall time.
+     * The Linux host build (src/linux) uses CLOCK_MONOTONIC */
+    if (CLOCKS_PER_SEC >= 1000000)
+        return clock() / (CLOCKS_PER_SEC / 1000000);
+    return clock() * (1000000 / CLOCKS_PER_SEC);
+}
+
 static void I_GetRemoteEvents(void) {
     int idx = eventhead;
     int key;
@@ -213,8 +263,35 @@ void I_StartFrame(void) {
     /* Nothing to do */
 }
 
+/* Called by I_InitGraphics when the host granted SDL_CAP_EVRING */
+void I_InitEventRing(void) {
+    register evring_t *a0 asm("a0") = &evring;
+    register int a1 asm("a1") = EVRINGSIZE;
+    register long syscall_id asm("a7") = SDL_EVENT_RING;
+
+    asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(syscall_id) : "memory");
+    evringactive = 1;
+}
+
+/* Posts whatever the host queued, no trap when there is nothing */
+static void I_GetRingEvents(void) {
+    uint32_t tail = evring.tail;
+
+    while (tail != evring.head) {
+        /* Event contents are only valid once head moved past them */
+        __sync_synchronize();
+        D_PostEvent(&evring.events[tail & (EVRINGSIZE - 1)]);
+        tail++;
+        __sync_synchronize();
+        evring.tail = tail;
+    }
+}
+
 void I_StartTic(void) {
-    I_GetRemoteEvents();
+    if (evringactive)
+        I_GetRingEvents();
+    else
+        I_GetRemoteEvents();
 }
 
 ticcmd_t *I_BaseTiccmd(void) {
@@ -21,14 +21,51 @@
 #include <string.h>
 
 #include "../doomdef.h"
+#include "../doomstat.h"
 
 #include "../d_event.h"
 #include "i_system.h"
 #include "i_video.h"
 #include "v_video.h"
+#include "w_wad.h"
+#include "z_zone.h"
+
+/* One SDL_WRITE_FB_RECT record, see doomdef.h */
+typedef struct {
+    uint32_t y;
+    uint32_t rows;
+    uint32_t rlesize;
+    uint32_t data;
+} fbrect_t;
+
+/* Worst case RLE output we bother with, past that rows go raw */
+#define FB_RLESIZE (SCREENWIDTH * SCREENHEIGHT / 2)
+
+static int fbcaps;              /* SDL_CAP_* granted by the host */
+static byte *fbprev;            /* Frame the host currently has */
+static byte *fbrle;
+static fbrect_t fbrects[SCREENHEIGHT];
+static int fbfull = 1;          /* Next update must be a full frame */
+
+/* With SDL_CAP_ASYNC screens[0] alternates between two buffers, the
+ * host reads the one last sent while the next frame is drawn in the
+ * other, which starts out as a copy of it */
+static byte *fbbuf[2];
+static int fbcur;
+static unsigned fbsent;         /* Writes handed to the host */
+
+/* PLAYPAL packed to 0xRRGGBB, one table per gamma level, built the
+ * first time that level is used */
+static int playpallump = -1;
+static int numplaypals;
+static uint32_t *paltables[5];
+static int curpal = -1;         /* Palette and gamma last shown */
+static int curgamma = -1;
+static int palselect;           /* Host keeps the palettes */
+static int palloaded = -1;      /* Gamma level the host has */
 
 void I_InitGraphics(void) {
-    /* Don't need to do anything really ... */
+    int caps;
 
     /* Ok, maybe just set gamma default */
     usegamma = 1;
@@ -38,9 +75,38 @@ void I_InitGraphics(void) {
     register int a1 asm("a1") = SCREENWIDTH;
     register int a2 asm("a2") = SCREENHEIGHT;
     register size_t a3 asm("a3") = MAXEVENTS;
+    register int a4 asm("a4") = SDL_CAP_RECT | SDL_CAP_RLE | SDL_CAP_ASYNC | SDL_CAP_EVRING | SDL_CAP_PALSEL;
     register long syscall_id asm("a7") = SDL_INIT;
 
-    asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(a2), "r"(a3), "r"(syscall_id) : "memory");
+    asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(a2), "r"(a3), "r"(a4), "r"(syscall_id) : "memory");
+
+    /* Hosts that predate the capabilities don't answer with the
+     * magic, they only get full frames */
+    caps = (int)(uintptr_t)a0;
+    if ((caps & ~0xff) != SDL_CAP_MAGIC)
+        return;
+
+    if (caps & SDL_CAP_EVRING)
+        I_InitEventRing();
+
+    palselect = caps & SDL_CAP_PALSEL;
+
+    fbcaps = caps & (SDL_CAP_RECT | SDL_CAP_RLE | SDL_CAP_ASYNC);
+
+    if (!(fbcaps & SDL_CAP_RECT))
+        fbcaps &= ~SDL_CAP_RLE;
+
+    if (fbcaps & SDL_CAP_RLE)
+        fbrle = Z_Malloc(FB_RLESIZE, PU_STATIC, NULL);
+
+    /* The buffer not drawn into is the frame the host has, so it
+     * doubles as the previous frame for the row compare */
+    if (fbcaps & SDL_CAP_ASYNC) {
+        fbbuf[0] = screens[0];
+        fbbuf[1] = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
+    } else if (fbcaps & SDL_CAP_RECT) {
+        fbprev = Z_Malloc(SCREENWIDTH * SCREENHEIGHT, PU_STATIC, NULL);
+    }
 }
 
 void I_ShutdownGraphics(void) {
@@ -50,39 +116,212 @@ void I_ShutdownGraphics(void) {
     asm volatile("ecall" : "+r"(a0) : "r"(syscall_id));
 }
 
-void I_SetPalette(byte *palette) {
-    uint32_t buffer[256];
+static void I_PackPalettes(uint32_t *buffer, const byte *palette, int count) {
     byte r, g, b;
 
-    for (int i = 0; i < 256; i++) {
+    for (int i = 0; i < count * 256; i++) {
         r = gammatable[usegamma][*palette++];
         g = gammatable[usegamma][*palette++];
         b = gammatable[usegamma][*palette++];
         buffer[i] = ((uint32_t) r << 16) | ((uint32_t) g << 8) | ((uint32_t) b);
     }
+}
 
+static void I_WritePalette(uint32_t *buffer) {
     register uint32_t *a0 asm("a0") = buffer;
     register size_t a1 asm("a1") = 256;
     register long syscall_id asm("a7") = SDL_WRITE_PALETTE;
     asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(syscall_id) : "memory");
 }
 
+static void I_SelectPalette(int pal) {
+    if (palloaded != usegamma) {
+        register uint32_t *a0 asm("a0") = paltables[usegamma];
+        register size_t a1 asm("a1") = numplaypals;
+        register long syscall_id asm("a7") = SDL_LOAD_PALETTES;
+        asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(syscall_id) : "memory");
+        palloaded = usegamma;
+    }
+
+    register int a0 asm("a0") = pal;
+    register long syscall_id asm("a7") = SDL_SELECT_PALETTE;
+    asm volatile("ecall" : "+r"(a0) : "r"(syscall_id) : "memory");
+}
+
+void I_SetPalette(byte *palette) {
+    uint32_t buffer[256];
+    byte *playpal;
+    int pal;
+
+    /* Callers pass a palette straight out of the cached PLAYPAL, so
+     * the offset tells which one it is */
+    if (playpallump == -1) {
+        playpallump = W_GetNumForName("PLAYPAL");
+        numplaypals = W_LumpLength(playpallump) / 768;
+    }
+    playpal = W_CacheLumpNum(playpallump, PU_CACHE);
+    pal = palette - playpal;
+
+    if (pal < 0 || pal % 768 || pal / 768 >= numplaypals) {
+        I_PackPalettes(buffer, palette, 1);
+        I_WritePalette(buffer);
+        curpal = -1;
+        return;
+    }
+    pal /= 768;
+
+    if (pal == curpal && usegamma == curgamma)
+        return;
+    curpal = pal;
+    curgamma = usegamma;
+
+    if (!paltables[usegamma]) {
+        paltables[usegamma] = Z_Malloc(numplaypals * 256 * sizeof(uint32_t), PU_STATIC, NULL);
+        I_PackPalettes(paltables[usegamma], playpal, numplaypals);
+    }
+
+    if (palselect)
+        I_SelectPalette(pal);
+    else
+        I_WritePalette(paltables[usegamma] + pal * 256);
+}
+
 void I_UpdateNoBlit(void) {
 }
 
-void I_FinishUpdate(void) {
-    /* Copy from RAM buffer to frame buffer */
+/* Encodes len bytes as (run, color) pairs, returns the encoded
+ * size or 0 when it would not fit in room or not save anything */
+static int I_EncodeRLE(const byte *src, int len, byte *dst, int room) {
+    const byte *end = src + len;
+    int size = 0;
+    int run;
+
+    if (room > len)
+        room = len;
+
+    while (src < end) {
+        run = 1;
+        while (src + run < end && run < 255 && src[run] == src[0])
+            run++;
+
+        if (size + 2 >= room)
+            return 0;
+
+        dst[size++] = run;
+        dst[size++] = src[0];
+        src += run;
+    }
+
+    return size;
+}
+
+/* Waits for the host to be done with everything sent so far */
+static void I_WaitFrames(void) {
+    for (;;) {
+        register unsigned a0 asm("a0");
+        register long syscall_id asm("a7") = SDL_FB_FENCE;
+
+        asm volatile("ecall" : "=r"(a0) : "r"(syscall_id) : "memory");
+
+        if ((int)(a0 - fbsent) >= 0)
+            break;
+    }
+}
+
+static void I_WriteFullFrame(void) {
     register long syscall_id asm("a7") = SDL_WRITE_FB;
     register byte *screen asm("a0") = screens[0];
 
     asm volatile("ecall" : "+r"(screen) : "r"(syscall_id) : "memory");
+}
+
+/* Sends the runs of rows that differ from what the host has,
+ * returns 0 when nothing did */
+static int I_WriteFrameRects(void) {
+    byte *src = screens[0];
+    byte *prev = fbprev;
+    fbrect_t *rect;
+    int rleused = 0;
+    int count = 0;
+    int size;
+    int y, y0;
+
+    for (y = 0; y < SCREENHEIGHT;) {
+        if (!memcmp(src + y * SCREENWIDTH, prev + y * SCREENWIDTH, SCREENWIDTH)) {
+            y++;
+            continue;
+        }
+
+        y0 = y;
+        do {
+            memcpy(prev + y * SCREENWIDTH, src + y * SCREENWIDTH, SCREENWIDTH);
+            y++;
+        } while (y < SCREENHEIGHT
+                 && memcmp(src + y * SCREENWIDTH, prev + y * SCREENWIDTH, SCREENWIDTH));
+
+        rect = &fbrects[count++];
+        rect->y = y0;
+        rect->rows = y - y0;
+        rect->rlesize = 0;
+        rect->data = (uintptr_t)(src + y0 * SCREENWIDTH);
+
+        if (fbcaps & SDL_CAP_RLE) {
+            size = I_EncodeRLE(src + y0 * SCREENWIDTH, rect->rows * SCREENWIDTH,
+                               fbrle + rleused, FB_RLESIZE - rleused);
+            if (size) {
+                rect->rlesize = size;
+                rect->data = (uintptr_t)(fbrle + rleused);
+                rleused += size;
+            }
+        }
+    }
+
+    if (!count)
+        return 0;
+
+    register fbrect_t *a0 asm("a0") = fbrects;
+    register int a1 asm("a1") = count;
+    register long syscall_id asm("a7") = SDL_WRITE_FB_RECT;
+
+    asm volatile("ecall" : "+r"(a0) : "r"(a1), "r"(syscall_id) : "memory");
+    return 1;
+}
+
+void I_FinishUpdate(void) {
+    int sent = 1;
+
+    /* The other buffer, fbrects and fbrle are free again once the
+     * host is done with the previous frame */
+    if (fbcaps & SDL_CAP_ASYNC) {
+        I_WaitFrames();
+        fbprev = fbbuf[fbcur ^ 1];
+    }
+
+    /* Copy from RAM buffer to frame buffer, only what changed if the
+     * host can take it. Either way fbprev ends up matching screens[0] */
+    if ((fbcaps & SDL_CAP_RECT) && !fbfull) {
+        sent = I_WriteFrameRects();
+    } else {
+        I_WriteFullFrame();
+        if (fbprev)
+            memcpy(fbprev, screens[0], SCREENWIDTH * SCREENHEIGHT);
+        fbfull = 0;
+    }
+
+    /* Draw the next frame in the other buffer while the host reads */
+    if ((fbcaps & SDL_CAP_ASYNC) && sent) {
+        fbsent++;
+        fbcur ^= 1;
+        screens[0] = fbbuf[fbcur];
+    }
 
-    /* Very crude FPS measure (time to render 100 frames */
+    /* Very crude FPS measure (time to render 100 frames),
+     * -timedemo reports proper numbers itself */
 #if 1
     static int frame_cnt = 0;
     static int tick_prev = 0;
 
-    if (++frame_cnt == 100) {
+    if (!timingdemo && ++frame_cnt == 100) {
         int tick_now = I_GetTime();
         printf("%d\n", tick_now - tick_prev);
         tick_prev = tick_now;
@@ -98,6 +337,8 @@ void I_WaitVBL(int count) {
     /*     ; */
 }
 
+/* screens[0] always starts out as the last frame sent, so this is
+ * what is on screen until the next I_FinishUpdate */
 void I_ReadScreen(byte *scr) {
     /* FIXME: Would have though reading from VID_FB_BASE be better ...
      *        but it seems buggy. Not sure if the problem is in the
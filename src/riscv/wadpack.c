@@ -0,0 +1,329 @@
+/*
+ * wadpack.c
+ *
+ * Host tool packing a WAD into a CWAD for W_AddFile,
+ * every lump that gets smaller as an LZ4 block.
+ *
+ * Usage: wadpack in.wad out.wad
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "w_wad.h"
+
+/* LZ4 block rules: the last 5 bytes are literals and the
+ * last match starts at least 12 bytes before the end */
+#define MINMATCH     4
+#define LASTLITERALS 5
+#define MFLIMIT      12
+#define MAXOFFSET    65535
+
+#define HASHBITS     15
+#define MAXCHAIN     256
+
+static int hashhead[1 << HASHBITS];
+static int *hashprev;
+
+static uint32_t get32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static void put32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static unsigned hash4(const uint8_t *p)
+{
+    return (get32(p) * 2654435761u) >> (32 - HASHBITS);
+}
+
+static uint8_t *putcount(uint8_t *out, int count)
+{
+    for (; count >= 255; count -= 255)
+        *out++ = 255;
+    *out++ = count;
+    return out;
+}
+
+/* One sequence: literals, then a match unless length is 0 */
+static uint8_t *putsequence(uint8_t *out, const uint8_t *lit, int litlen,
+                            int offset, int length)
+{
+    uint8_t *token = out++;
+
+    *token = (litlen < 15 ? litlen : 15) << 4;
+    if (litlen >= 15)
+        out = putcount(out, litlen - 15);
+    memcpy(out, lit, litlen);
+    out += litlen;
+
+    if (length) {
+        *out++ = offset;
+        *out++ = offset >> 8;
+        length -= MINMATCH;
+        *token |= length < 15 ? length : 15;
+        if (length >= 15)
+            out = putcount(out, length - 15);
+    }
+    return out;
+}
+
+/* Greedy parse over hash chains, out needs size + size/255 + 16 */
+static int lz4pack(const uint8_t *in, int size, uint8_t *out)
+{
+    const uint8_t *anchor = in;
+    uint8_t *op = out;
+    int ip, cand, len, best, bestoff, depth;
+    unsigned h;
+
+    memset(hashhead, -1, sizeof(hashhead));
+
+    for (ip = 0; ip < size - MFLIMIT;) {
+        h = hash4(in + ip);
+        best = 0;
+        bestoff = 0;
+
+        for (cand = hashhead[h], depth = 0;
+             cand >= 0 && ip - cand <= MAXOFFSET && depth < MAXCHAIN;
+             cand = hashprev[cand], depth++) {
+            for (len = 0; ip + len < size - LASTLITERALS &&
+                          in[cand + len] == in[ip + len]; len++)
+                ;
+            if (len > best) {
+                best = len;
+                bestoff = ip - cand;
+            }
+        }
+
+        hashprev[ip] = hashhead[h];
+        hashhead[h] = ip;
+
+        if (best < MINMATCH) {
+            ip++;
+            continue;
+        }
+
+        op = putsequence(op, anchor, in + ip - anchor, bestoff, best);
+
+        /* keep the chains going through the match */
+        while (--best) {
+            ip++;
+            if (ip < size - MFLIMIT) {
+                h = hash4(in + ip);
+                hashprev[ip] = hashhead[h];
+                hashhead[h] = ip;
+            }
+        }
+        ip++;
+        anchor = in + ip;
+    }
+
+    op = putsequence(op, anchor, in + size - anchor, 0, 0);
+    return op - out;
+}
+
+/* Same decoder as W_Unpack, to check every packed lump */
+static int lz4unpack(const uint8_t *src, int srclen, uint8_t *dest, int destlen)
+{
+    const uint8_t *srcend = src + srclen;
+    uint8_t *out = dest, *destend = dest + destlen;
+    const uint8_t *match;
+    int token, count, b;
+
+    while (src < srcend) {
+        token = *src++;
+        count = token >> 4;
+        if (count == 15)
+            do {
+                if (src >= srcend)
+                    return -1;
+                count += b = *src++;
+            } while (b == 255);
+        if (count > srcend - src || count > destend - out)
+            return -1;
+        memcpy(out, src, count);
+        src += count;
+        out += count;
+        if (src == srcend)
+            break;
+
+        if (srcend - src < 2)
+            return -1;
+        match = out - (src[0] | (src[1] << 8));
+        src += 2;
+        if (match < dest || match == out)
+            return -1;
+        count = (token & 15) + MINMATCH;
+        if (count == 15 + MINMATCH)
+            do {
+                if (src >= srcend)
+                    return -1;
+                count += b = *src++;
+            } while (b == 255);
+        if (count > destend - out)
+            return -1;
+        while (count--)
+            *out++ = *match++;
+    }
+    return out - dest;
+}
+
+static uint8_t *readfile(const char *name, long *size)
+{
+    FILE *f = fopen(name, "rb");
+    uint8_t *data;
+
+    if (!f)
+        return NULL;
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = malloc(*size);
+    if (!data || fread(data, 1, *size, f) != (size_t) *size) {
+        fclose(f);
+        return NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+int main(int argc, char *argv[])
+{
+    uint8_t *wad, *out, *check, *lump;
+    long wadsize;
+    int numlumps, infotableofs, filepos, size, packedsize, i;
+    int maxsize, outsize, pos, totalsize, totalpacked, numpacked;
+    long sumsize;
+    clock_t unpacktime;
+    uint8_t *dir;
+    FILE *f;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s in.wad out.wad\n", argv[0]);
+        return 1;
+    }
+
+    wad = readfile(argv[1], &wadsize);
+    if (!wad || wadsize < 12 ||
+        (memcmp(wad, "IWAD", 4) && memcmp(wad, "PWAD", 4))) {
+        fprintf(stderr, "%s: not a WAD\n", argv[1]);
+        return 1;
+    }
+
+    numlumps = get32(wad + 4);
+    infotableofs = get32(wad + 8);
+    if (numlumps < 0 || infotableofs < 12 ||
+        infotableofs + (long) numlumps * sizeof(filelump_t) > wadsize) {
+        fprintf(stderr, "%s: bad directory\n", argv[1]);
+        return 1;
+    }
+
+    maxsize = 0;
+    sumsize = 0;
+    for (i = 0; i < numlumps; i++) {
+        size = get32(wad + infotableofs + i * sizeof(filelump_t) + 4);
+        if (size > maxsize)
+            maxsize = size;
+        if (size > 0)
+            sumsize += size;
+    }
+
+    /* every lump stored at worst, plus padding and directory */
+    out = malloc(12 + sumsize + 4 * numlumps +
+                 numlumps * sizeof(packedlump_t));
+    lump = malloc(maxsize + maxsize / 255 + 16);
+    check = malloc(maxsize + 1);
+    hashprev = malloc((maxsize + 1) * sizeof(*hashprev));
+    dir = malloc(numlumps * sizeof(packedlump_t) + 1);
+    if (!out || !lump || !check || !hashprev || !dir) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    pos = 12;
+    totalsize = totalpacked = numpacked = 0;
+    unpacktime = 0;
+
+    for (i = 0; i < numlumps; i++) {
+        const uint8_t *entry = wad + infotableofs + i * sizeof(filelump_t);
+        uint8_t *de = dir + i * sizeof(packedlump_t);
+        clock_t start;
+
+        filepos = get32(entry);
+        size = get32(entry + 4);
+        if (filepos < 0 || size < 0 || filepos + (long) size > wadsize) {
+            fprintf(stderr, "%s: lump %i out of the file\n", argv[1], i);
+            return 1;
+        }
+
+        packedsize = size ? lz4pack(wad + filepos, size, lump) : 0;
+
+        /* keep it only if it saves at least a word */
+        if (packedsize && packedsize + 4 <= size) {
+            start = clock();
+            if (lz4unpack(lump, packedsize, check, maxsize + 1) != size ||
+                memcmp(check, wad + filepos, size)) {
+                fprintf(stderr, "lump %i doesn't unpack back\n", i);
+                return 1;
+            }
+            unpacktime += clock() - start;
+            memcpy(out + pos, lump, packedsize);
+            numpacked++;
+        } else {
+            memcpy(out + pos, wad + filepos, size);
+            packedsize = 0;
+        }
+
+        put32(de, pos);
+        put32(de + 4, size);
+        put32(de + 8, packedsize);
+        memcpy(de + 12, entry + 8, 8);
+
+        totalsize += size;
+        totalpacked += packedsize ? packedsize : size;
+
+        /* stored lumps are used in place when mapped, word align */
+        pos += packedsize ? packedsize : size;
+        while (pos & 3)
+            out[pos++] = 0;
+    }
+
+    memcpy(out, "CWAD", 4);
+    put32(out + 4, numlumps);
+    put32(out + 8, pos);
+    memcpy(out + pos, dir, numlumps * sizeof(packedlump_t));
+    outsize = pos + numlumps * sizeof(packedlump_t);
+
+    f = fopen(argv[2], "wb");
+    if (!f || fwrite(out, 1, outsize, f) != (size_t) outsize || fclose(f)) {
+        fprintf(stderr, "%s: can't write\n", argv[2]);
+        return 1;
+    }
+
+    printf("%s: %ld -> %i bytes (%i%%), %i of %i lumps packed\n",
+           argv[2], wadsize, outsize, (int) (outsize * 100LL / wadsize),
+           numpacked, numlumps);
+    printf("lump data %i -> %i bytes, host unpack %.1f MB/s\n",
+           totalsize, totalpacked,
+           unpacktime ? totalsize / 1e6 / ((double) unpacktime / CLOCKS_PER_SEC) : 0.0);
+    return 0;
+}
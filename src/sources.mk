@@ -13,6 +13,7 @@ SOURCES_doom := \
 	hu_stuff.c \
 	info.c \
 	m_argv.c \
+	m_bench.c \
 	m_bbox.c \
 	m_cheat.c \
 	m_fixed.c \
@@ -86,6 +87,7 @@ HEADERS_doom := \
 	i_system.h \
 	i_video.h \
 	m_argv.h \
+	m_bench.h \
 	m_bbox.h \
 	m_cheat.h \
 	m_fixed.h \
@@ -28,6 +28,7 @@ rcsid[] = "$Id: w_wad.c,v 1.5 1997/02/03 16:47:57 b1 Exp $";
 
 #ifdef NORMALUNIX
 #include <ctype.h>
+#include <stdlib.h>
 #include <sys/types.h>
 #include <string.h>
 #include <unistd.h>
@@ -39,6 +40,8 @@ rcsid[] = "$Id: w_wad.c,v 1.5 1997/02/03 16:47:57 b1 Exp $";
 #endif
 
 #include "doomtype.h"
+#include "doomdata.h"
+#include "m_argv.h"
 #include "m_swap.h"
 #include "i_system.h"
 #include "z_zone.h"
@@ -63,6 +66,33 @@ int                     numlumps;
 
 void**                  lumpcache;
 
+// Lump class of each lump, from its name or marker range.
+byte*                   lumpclass;
+
+lumpstats_t             lumpstats[NUMLUMPCLASSES];
+
+// LRU list of the lumps in lumpcache, most recent first.
+// The zone may still purge a lump or its owner free it,
+//  W_SweepLumps drops such entries before the list or
+//  its byte count is used.
+typedef struct
+{
+    int         prev;
+    int         next;   // -1 if not in the list
+    int         size;   // as counted in lumpcachebytes
+
+} lrunode_t;
+
+static lrunode_t*       lrunodes;       // [numlumps+1], numlumps is the head
+static int              lumpcachebytes;
+static int              lumpcachebudget;
+
+// Name hash over lumpinfo, chained through lumpinfo_t->next.
+// Chains are kept in descending lump order, so the first
+//  match is always the one a backwards scan would find.
+static int*             lumphash;
+static unsigned         lumphashsize;
+
 
 #define strcmpi strcasecmp
 
@@ -119,6 +149,75 @@ ExtractFileBase
 
 
 
+//
+// LUMP NAME HASHING
+//
+
+//
+// W_HashName
+// Both halves of the name come from the same
+//  8 byte, zero padded buffer W_CheckNumForName compares.
+//
+static unsigned W_HashName (int v1, int v2)
+{
+    unsigned    h;
+
+    h = (unsigned)v1 * 0x9e3779b1u;
+    h ^= (unsigned)v2 * 0x85ebca6bu;
+    h ^= h >> 15;
+
+    return h & (lumphashsize-1);
+}
+
+
+//
+// W_HashLumps
+// Builds the name hash for all of lumpinfo,
+//  once the last file is added.
+// Lumps are inserted at the chain heads in ascending
+//  order, so later files override earlier ones just
+//  like the old backwards scan, and repeated markers
+//  (S_START, F_START...) resolve to the same lump.
+//
+static void W_HashLumps (void)
+{
+    unsigned    size;
+    int         i;
+    int         h;
+    union {
+        char    s[8];
+        int     x[2];
+    } name8;
+
+    // power of two, at least twice the lump count
+    for (size = 1 ; size < 2*(unsigned)numlumps ; size <<= 1)
+        ;
+
+    if (size != lumphashsize)
+    {
+        free (lumphash);
+        lumphash = malloc (size*sizeof(*lumphash));
+
+        if (!lumphash)
+            I_Error ("Couldn't allocate lumphash");
+
+        lumphashsize = size;
+    }
+
+    memset (lumphash, -1, lumphashsize*sizeof(*lumphash));
+
+    for (i=0 ; i<numlumps ; i++)
+    {
+        memcpy (name8.s, lumpinfo[i].name, 8);
+        h = W_HashName (name8.x[0], name8.x[1]);
+        lumpinfo[i].next = lumphash[h];
+        lumphash[h] = i;
+    }
+}
+
+
+
+
 //
 // LUMP BASED ROUTINES.
 //
@@ -135,6 +234,9 @@ ExtractFileBase
 // If filename starts with a tilde, the file is handled
 //  specially to allow map reloads.
 // But: the reload feature is a fragile hack...
+//
+// Only W_InitMultipleFiles adds files, it sizes the
+//  hash and the per lump tables after the last one.
 
 int                     reloadlump;
 char*                   reloadname;
@@ -151,6 +253,9 @@ void W_AddFile (char *filename)
     filelump_t*         fileinfo;
     filelump_t          singleinfo;
     int                 storehandle;
+    byte*               filebase;
+    packedlump_t*       packedinfo;
+    boolean             packed;
 
     // open the file and add to directory
 
@@ -170,6 +275,8 @@ void W_AddFile (char *filename)
 
     printf (" adding %s\n",filename);
     startlump = numlumps;
+    packedinfo = NULL;
+    packed = false;
 
     if (strcmpi (filename+strlen(filename)-3 , "wad" ) )
     {
@@ -184,7 +291,12 @@ void W_AddFile (char *filename)
     {
         // WAD file
         read (handle, &header, sizeof(header));
-        if (strncmp(header.identification,"IWAD",4))
+        if (!strncmp(header.identification,"CWAD",4))
+        {
+            // packed by wadpack
+            packed = true;
+        }
+        else if (strncmp(header.identification,"IWAD",4))
         {
             // Homebrew levels?
             if (strncmp(header.identification,"PWAD",4))
@@ -200,7 +312,26 @@ void W_AddFile (char *filename)
         length = header.numlumps*sizeof(filelump_t);
         fileinfo = alloca (length);
         lseek (handle, header.infotableofs, SEEK_SET);
-        read (handle, fileinfo, length);
+
+        if (packed)
+        {
+            if (reloadname)
+                I_Error ("Packed wad file %s can't be reloaded "
+                         "or follow a reloadable file", filename);
+
+            packedinfo = alloca (header.numlumps*sizeof(packedlump_t));
+            read (handle, packedinfo, header.numlumps*sizeof(packedlump_t));
+
+            for (i=0 ; i<header.numlumps ; i++)
+            {
+                fileinfo[i].filepos = packedinfo[i].filepos;
+                fileinfo[i].size = packedinfo[i].size;
+                memcpy (fileinfo[i].name, packedinfo[i].name, 8);
+            }
+        }
+        else
+            read (handle, fileinfo, length);
+
         numlumps += header.numlumps;
     }
 
@@ -215,12 +346,34 @@ void W_AddFile (char *filename)
 
     storehandle = reloadname ? -1 : handle;
 
+    // reloadable files change under us, never map those
+    filebase = reloadname ? NULL : I_MapWadFile (handle, filelength (handle));
+
     for (i=startlump ; i<numlumps ; i++,lump_p++, fileinfo++)
     {
         lump_p->handle = storehandle;
         lump_p->position = LONG(fileinfo->filepos);
         lump_p->size = LONG(fileinfo->size);
         strncpy (lump_p->name, fileinfo->name, 8);
+
+        // packed lumps are unpacked into the cache on a miss
+        lump_p->packedsize = 0;
+        lump_p->packed = NULL;
+        if (packedinfo && packedinfo->packedsize)
+        {
+            lump_p->packedsize = LONG(packedinfo->packedsize);
+            if (filebase)
+                lump_p->packed = filebase + lump_p->position;
+        }
+        if (packedinfo)
+            packedinfo++;
+
+        // lump structs are read with word loads,
+        //  so unaligned lumps still go through the cache
+        if (filebase && !(lump_p->position & 3) && !lump_p->packedsize)
+            lump_p->data = filebase + lump_p->position;
+        else
+            lump_p->data = NULL;
     }
 
     if (reloadname)
@@ -234,6 +387,8 @@ void W_AddFile (char *filename)
 // W_Reload
 // Flushes any of the reloadable lumps in memory
 //  and reloads the directory.
+// Only positions and sizes change, the lump names
+//  (and so the name hash) stay as they were.
 //
 void W_Reload (void)
 {
@@ -278,6 +433,195 @@ void W_Reload (void)
 
 
 
+//
+// LUMP CACHE
+//
+
+//
+// W_ClassifyLumps
+// Sprites, flats and patches go by their marker ranges,
+//  sounds and music by prefix, maps by their marker lump
+//  and the lumps after it.
+//
+static void W_ClassifyLumps (void)
+{
+    lumpinfo_t* lump_p;
+    int         range;
+    int         maplumps;
+    int         i;
+
+    lumpclass = realloc (lumpclass, numlumps);
+    if (!lumpclass)
+        I_Error ("Couldn't allocate lumpclass");
+
+    range = lc_other;
+    maplumps = 0;
+
+    for (i=0, lump_p = lumpinfo ; i<numlumps ; i++, lump_p++)
+    {
+        if (!strncmp (lump_p->name, "S_START", 8)
+            || !strncmp (lump_p->name, "SS_START", 8))
+            range = lc_sprite;
+        else if (!strncmp (lump_p->name, "F_START", 8)
+                 || !strncmp (lump_p->name, "FF_START", 8))
+            range = lc_flat;
+        else if (!strncmp (lump_p->name, "P_START", 8)
+                 || !strncmp (lump_p->name, "PP_START", 8))
+            range = lc_patch;
+
+        if ((lump_p->name[0] == 'E' && lump_p->name[2] == 'M'
+             && !lump_p->name[4])
+            || (!strncmp (lump_p->name, "MAP", 3) && !lump_p->name[5]))
+        {
+            maplumps = ML_BLOCKMAP+1;   // the marker and its lumps
+        }
+
+        if (maplumps)
+        {
+            lumpclass[i] = lc_map;
+            maplumps--;
+        }
+        else if (range != lc_other)
+            lumpclass[i] = range;
+        else if (!strncmp (lump_p->name, "DS", 2)
+                 || !strncmp (lump_p->name, "DP", 2))
+            lumpclass[i] = lc_sound;
+        else if (!strncmp (lump_p->name, "D_", 2))
+            lumpclass[i] = lc_music;
+        else
+            lumpclass[i] = lc_other;
+
+        // not F1_END, P2_END... which sit inside the ranges
+        if (!strncmp (lump_p->name, "S_END", 8)
+            || !strncmp (lump_p->name, "SS_END", 8)
+            || !strncmp (lump_p->name, "F_END", 8)
+            || !strncmp (lump_p->name, "FF_END", 8)
+            || !strncmp (lump_p->name, "P_END", 8)
+            || !strncmp (lump_p->name, "PP_END", 8))
+            range = lc_other;
+    }
+}
+
+
+//
+// W_InitLumpCache
+// The byte budget for cached lumps comes from -lumpcache
+//  (in KB, 0 leaves it all to the zone).
+//
+static void W_InitLumpCache (void)
+{
+    int         i;
+
+    W_ClassifyLumps ();
+
+    lumpcachebudget = LUMPCACHESIZE;
+    i = M_CheckParm ("-lumpcache");
+    if (i && i < myargc-1)
+        lumpcachebudget = atoi (myargv[i+1])*1024;
+
+    lrunodes = malloc ((numlumps+1)*sizeof(*lrunodes));
+    if (!lrunodes)
+        I_Error ("Couldn't allocate lrunodes");
+
+    for (i=0 ; i<numlumps ; i++)
+        lrunodes[i].next = -1;
+
+    lrunodes[numlumps].prev = lrunodes[numlumps].next = numlumps;
+    lumpcachebytes = 0;
+}
+
+
+static void W_UnlinkLump (int lump)
+{
+    lrunode_t*  node;
+
+    node = &lrunodes[lump];
+    lrunodes[node->prev].next = node->next;
+    lrunodes[node->next].prev = node->prev;
+    node->next = -1;
+
+    lumpcachebytes -= node->size;
+}
+
+
+static void W_LinkLump (int lump, int size)
+{
+    lrunode_t*  node;
+    lrunode_t*  head;
+
+    node = &lrunodes[lump];
+    head = &lrunodes[numlumps];
+
+    node->size = size;
+    lumpcachebytes += size;
+
+    node->prev = numlumps;
+    node->next = head->next;
+    lrunodes[head->next].prev = lump;
+    head->next = lump;
+}
+
+
+//
+// W_SweepLumps
+// Unlinks the lumps the zone purged or their
+//  owners freed, so lumpcachebytes is only
+//  what is really cached.
+//
+static void W_SweepLumps (void)
+{
+    int         lump;
+    int         prev;
+
+    for (lump = lrunodes[numlumps].prev ; lump != numlumps ; lump = prev)
+    {
+        prev = lrunodes[lump].prev;
+
+        if (!lumpcache[lump])
+        {
+            W_UnlinkLump (lump);
+            lumpstats[lumpclass[lump]].purges++;
+        }
+    }
+}
+
+
+//
+// W_MakeLumpRoom
+// Frees the least recently used purgable lumps
+//  until size more bytes fit in the budget.
+// Lumps tagged below PU_PURGELEVEL are in use and stay.
+//
+static void W_MakeLumpRoom (int size)
+{
+    memblock_t* block;
+    int         lump;
+    int         prev;
+
+    if (!lumpcachebudget || lumpcachebytes + size <= lumpcachebudget)
+        return;
+
+    // stale entries first, they may be all the room needed
+    W_SweepLumps ();
+
+    for (lump = lrunodes[numlumps].prev ;
+         lump != numlumps && lumpcachebytes + size > lumpcachebudget ;
+         lump = prev)
+    {
+        prev = lrunodes[lump].prev;
+
+        block = (memblock_t *) ( (byte *)lumpcache[lump] - sizeof(memblock_t));
+        if (block->tag < PU_PURGELEVEL)
+            continue;
+
+        Z_Free (lumpcache[lump]);
+        W_UnlinkLump (lump);
+        lumpstats[lumpclass[lump]].evictions++;
+    }
+}
+
+
+
 //
 // W_InitMultipleFiles
 // Pass a null terminated list of files to use.
@@ -315,6 +659,9 @@ void W_InitMultipleFiles (char** filenames)
         I_Error ("Couldn't allocate lumpcache");
 
     memset (lumpcache,0, size);
+
+    W_HashLumps ();
+    W_InitLumpCache ();
 }
 
 
@@ -360,6 +707,7 @@ int W_CheckNumForName (char* name)
 
     int         v1;
     int         v2;
+    int         i;
     lumpinfo_t* lump_p;
 
     // make the name into two integers for easy compares
@@ -375,15 +723,16 @@ int W_CheckNumForName (char* name)
     v2 = name8.x[1];
 
 
-    // scan backwards so patch lump files take precedence
-    lump_p = lumpinfo + numlumps;
-
-    while (lump_p-- != lumpinfo)
+    // chains run from the last lump added backwards,
+    //  so patch lump files take precedence
+    for (i = lumphash[W_HashName (v1, v2)] ; i != -1 ; i = lump_p->next)
     {
+        lump_p = &lumpinfo[i];
+
         if ( *(int *)lump_p->name == v1
              && *(int *)&lump_p->name[4] == v2)
         {
-            return lump_p - lumpinfo;
+            return i;
         }
     }
 
@@ -425,10 +774,125 @@ int W_LumpLength (int lump)
 
 
 
+//
+// W_DirectoryKey
+// Hash of every lump name, position and size, for
+//  files of data computed from the lumps. Cheap, but
+//  blind to lumps edited in place at the same size.
+//
+unsigned W_DirectoryKey (void)
+{
+    lumpinfo_t* lump_p;
+    unsigned    key;
+    int         i;
+    int         j;
+
+    key = numlumps;
+    for (i=0, lump_p = lumpinfo ; i<numlumps ; i++, lump_p++)
+    {
+        for (j=0 ; j<8 ; j++)
+            key = key*31 + lump_p->name[j];
+        key = key*31 + lump_p->position;
+        key = key*31 + lump_p->size;
+    }
+    return key;
+}
+
+
+
+//
+// W_Unpack
+// Decodes an LZ4 block: sequences of a token (literal
+//  count, match length - 4), the literals, a 16 bit
+//  little endian match offset and the match.
+// Counts of 15 go on in bytes, adding up to the first
+//  below 255. The last sequence is literals only.
+// Returns the unpacked size, or -1 for a bad block.
+//
+static int
+W_Unpack
+( byte*         src,
+  int           srclength,
+  byte*         dest,
+  int           destlength )
+{
+    byte*       srcend;
+    byte*       destend;
+    byte*       out;
+    byte*       match;
+    int         token;
+    int         count;
+    int         b;
+
+    srcend = src + srclength;
+    out = dest;
+    destend = dest + destlength;
+
+    while (src < srcend)
+    {
+        token = *src++;
+
+        // literals
+        count = token >> 4;
+        if (count == 15)
+        {
+            do
+            {
+                if (src >= srcend)
+                    return -1;
+                b = *src++;
+                count += b;
+            } while (b == 255);
+        }
+
+        if (count > srcend-src || count > destend-out)
+            return -1;
+        memcpy (out, src, count);
+        src += count;
+        out += count;
+
+        if (src == srcend)
+            break;      // last sequence
+
+        // match
+        if (srcend-src < 2)
+            return -1;
+        match = out - (src[0] | (src[1]<<8));
+        src += 2;
+        if (match < dest || match == out)
+            return -1;
+
+        count = (token & 15) + 4;
+        if (count == 19)
+        {
+            do
+            {
+                if (src >= srcend)
+                    return -1;
+                b = *src++;
+                count += b;
+            } while (b == 255);
+        }
+
+        if (count > destend-out)
+            return -1;
+
+        // may overlap, copy forwards
+        while (count--)
+            *out++ = *match++;
+    }
+
+    return out - dest;
+}
+
+
+
 //
 // W_ReadLump
 // Loads the lump into the given buffer,
 //  which must be >= W_LumpLength().
+// A packed lump may be read through a zone block,
+//  so the buffer must not be purgable.
 //
 void
 W_ReadLump
@@ -438,12 +902,47 @@ W_ReadLump
     int         c;
     lumpinfo_t* l;
     int         handle;
+    byte*       packed;
+    int         start;
 
     if (lump >= numlumps)
         I_Error ("W_ReadLump: %i >= numlumps",lump);
 
     l = lumpinfo+lump;
 
+    if (l->data)
+    {
+        memcpy (dest, l->data, l->size);
+        return;
+    }
+
+    if (l->packedsize)
+    {
+        // from the mapping, else read it in
+        packed = l->packed;
+        if (!packed)
+        {
+            packed = Z_Malloc (l->packedsize, PU_STATIC, NULL);
+            lseek (l->handle, l->position, SEEK_SET);
+            c = read (l->handle, packed, l->packedsize);
+
+            if (c < l->packedsize)
+                I_Error ("W_ReadLump: only read %i of %i on packed lump %i",
+                         c,l->packedsize,lump);
+        }
+
+        start = I_GetTimeUS ();
+        if (W_Unpack (packed, l->packedsize, dest, l->size) != l->size)
+            I_Error ("W_ReadLump: bad packed lump %i", lump);
+
+        lumpstats[lumpclass[lump]].unpackus += I_GetTimeUS () - start;
+        lumpstats[lumpclass[lump]].bytesfetched += l->packedsize;
+
+        if (packed != l->packed)
+            Z_Free (packed);
+        return;
+    }
+
     // ??? I_BeginRead ();
 
     if (l->handle == -1)
@@ -465,6 +964,8 @@ W_ReadLump
     if (l->handle == -1)
         close (handle);
 
+    lumpstats[lumpclass[lump]].bytesfetched += l->size;
+
     // ??? I_EndRead ();
 }
 
@@ -479,23 +980,53 @@ W_CacheLumpNum
 ( int           lump,
   int           tag )
 {
+    lumpstats_t*        stats;
+    int                 size;
+
     if ((unsigned)lump >= numlumps)
         I_Error ("W_CacheLumpNum: %i >= numlumps",lump);
 
+    // mapped lumps are used in place, the zone never sees them
+    if (lumpinfo[lump].data)
+    {
+        lumpstats[lumpclass[lump]].hits++;
+        return lumpinfo[lump].data;
+    }
+
+    stats = &lumpstats[lumpclass[lump]];
+
     if (!lumpcache[lump])
     {
         // read the lump in
+        if (lrunodes[lump].next != -1)
+        {
+            W_UnlinkLump (lump);
+            stats->purges++;
+        }
+
+        size = W_LumpLength (lump);
+        W_MakeLumpRoom (size);
 
-        //printf ("cache miss on lump %i\n",lump);
-        Z_Malloc (W_LumpLength (lump), tag, &lumpcache[lump]);
+        // static until read, reading a packed lump allocates
+        Z_Malloc (size, PU_STATIC, &lumpcache[lump]);
         W_ReadLump (lump, lumpcache[lump]);
+        Z_ChangeTag (lumpcache[lump], tag);
+
+        stats->misses++;
+        stats->bytesread += size;
     }
     else
     {
-        //printf ("cache hit on lump %i\n",lump);
+        stats->hits++;
         Z_ChangeTag (lumpcache[lump],tag);
+
+        size = lrunodes[lump].size;
+        W_UnlinkLump (lump);
     }
 
+    // most recently used
+    W_LinkLump (lump, size);
+
     return lumpcache[lump];
 }
 
@@ -515,10 +1046,19 @@ W_CacheLumpName
 
 //
 // W_Profile
+// Adds a column of cached lumps to waddump.txt,
+//  with the lump cache counters per lump class.
+// Bytes fetched against bytes read is what packing
+//  saves in file reads, unpack us what it costs.
 //
-int             info[2500][10];
+char            (*info)[10];    // numlumps rows
 int             profilecount;
 
+static char*    lumpclassnames[NUMLUMPCLASSES] =
+{
+    "other", "map", "flat", "sprite", "patch", "sound", "music"
+};
+
 void W_Profile (void)
 {
     int         i;
@@ -528,9 +1068,18 @@ void W_Profile (void)
     FILE*       f;
     int         j;
     char        name[9];
+    lumpstats_t* stats;
 
+    if (!info)
+    {
+        info = Z_Malloc (numlumps*sizeof(*info), PU_STATIC, 0);
+        memset (info, ' ', numlumps*sizeof(*info));
+    }
 
-    for (i=0 ; i<numlumps ; i++)
+    // settle what was freed since the last miss
+    W_SweepLumps ();
+
+    for (i=0 ; profilecount<10 && i<numlumps ; i++)
     {
         ptr = lumpcache[i];
         if (!ptr)
@@ -548,11 +1097,28 @@ void W_Profile (void)
         }
         info[i][profilecount] = ch;
     }
-    profilecount++;
+    if (profilecount < 10)
+        profilecount++;
 
     f = fopen ("waddump.txt","w");
+    if (!f)
+        return;
     name[8] = 0;
 
+    fprintf (f,"lump cache: %i of %i bytes\n",
+             lumpcachebytes, lumpcachebudget);
+    fprintf (f,"class        hits   misses evictions  purges  bytes read"
+             "  bytes fetched  unpack us\n");
+
+    for (i=0, stats = lumpstats ; i<NUMLUMPCLASSES ; i++, stats++)
+    {
+        fprintf (f,"%-8s %8i %8i %8i %8i %11i %14i %10i\n",
+                 lumpclassnames[i], stats->hits, stats->misses,
+                 stats->evictions, stats->purges, stats->bytesread,
+                 stats->bytesfetched, stats->unpackus);
+    }
+    fprintf (f,"\n");
+
     for (i=0 ; i<numlumps ; i++)
     {
         memcpy (name,lumpinfo[i].name,8);
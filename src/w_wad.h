@@ -24,6 +24,7 @@
 #ifndef __W_WAD__
 #define __W_WAD__
 
+#include "doomtype.h"
 
 #ifdef __GNUG__
 #pragma interface
@@ -51,6 +52,20 @@ typedef struct
 
 } filelump_t;
 
+//
+// Packed WAD ("CWAD"), written by riscv/wadpack.c.
+// Same header, the directory entries also give
+//  the packed size; packed lumps are LZ4 blocks.
+//
+typedef struct
+{
+    int                 filepos;
+    int                 size;           // unpacked
+    int                 packedsize;     // 0 if stored as is
+    char                name[8];
+
+} packedlump_t;
+
 //
 // WADFILE I/O related stuff.
 //
@@ -60,9 +75,47 @@ typedef struct
     int         handle;
     int         position;
     int         size;
+    int         next;   // next lump in name hash chain, -1 ends
+    byte*       data;   // lump in mapped WAD memory, or NULL
+    int         packedsize;     // LZ4 packed size in the file, or 0
+    byte*       packed;         // packed lump in mapped WAD memory, or NULL
 } lumpinfo_t;
 
 
+//
+// Lump cache telemetry, per lump class.
+//
+typedef enum
+{
+    lc_other,
+    lc_map,
+    lc_flat,
+    lc_sprite,
+    lc_patch,
+    lc_sound,
+    lc_music,
+    NUMLUMPCLASSES
+
+} lumpclass_t;
+
+typedef struct
+{
+    int         hits;
+    int         misses;
+    int         evictions;      // dropped for the byte budget
+    int         purges;         // purged by the zone or freed first
+    int         bytesread;      // into the cache
+    int         bytesfetched;   // from the file, packed or not
+    int         unpackus;       // microseconds spent unpacking
+
+} lumpstats_t;
+
+// Default byte budget for cached lumps, see -lumpcache.
+#define LUMPCACHESIZE   (2*1024*1024)
+
+extern  lumpstats_t     lumpstats[NUMLUMPCLASSES];
+extern  byte*           lumpclass;
+
 extern  void**          lumpcache;
 extern  lumpinfo_t*     lumpinfo;
 extern  int             numlumps;
@@ -74,11 +127,14 @@ int     W_CheckNumForName (char* name);
 int     W_GetNumForName (char* name);
 
 int     W_LumpLength (int lump);
+unsigned W_DirectoryKey (void);
 void    W_ReadLump (int lump, void *dest);
 
 void*   W_CacheLumpNum (int lump, int tag);
 void*   W_CacheLumpName (char* name, int tag);
 
+void    W_Profile (void);
+
 
 
 
@@ -44,6 +44,8 @@ rcsid[] = "$Id: z_zone.c,v 1.4 1997/02/03 16:47:58 b1 Exp $";
 
 #define ZONEID  0x1d4a11
 
+#define MINFRAGMENT             64
+
 
 typedef struct
 {
@@ -62,6 +64,47 @@ typedef struct
 memzone_t*      mainzone;
 
 
+//
+// SIZE CLASS POOLS
+//
+// Small ownerless requests (mobjs, thinkers...) are served
+//  from per size class free lists instead of the rover scan.
+// Only ownerless blocks qualify: Z_ChangeTag refuses to make
+//  those purgable, and the rover never sees a pool slot, so a
+//  slot must never become purgable.
+// Slots are carved out of PU_STATIC slabs allocated from the
+//  top of the zone, away from the level and cache blocks the
+//  rover hands out, and keep a full memblock_t header so the
+//  tag semantics, Z_ChangeTag and Z_FreeTags work unchanged.
+// Slots have a negative size and are chained on their pool's
+//  used list while allocated, on the free list otherwise.
+// Slabs are never given back, slots are reused for blocks
+//  of the same class.
+// Classes above ZONELINEPOOLS*ZONEPOOLGRAIN bytes (mobjs) are
+//  spaced by whole cache lines and start their data on one.
+//
+#define ZONEPOOLGRAIN           16
+#define NUMZONEPOOLS            16      // up to 256 byte requests
+#define ZONESLABSIZE            8192
+#define ZONELINE                64
+#define ZONELINEPOOLS           8       // above 128 byte requests
+
+typedef struct
+{
+    // distance between slots, including header
+    int         slotsize;
+
+    // start / end cap for allocated slots
+    memblock_t  used;
+
+    // singly linked through next
+    memblock_t* free;
+
+} zonepool_t;
+
+zonepool_t      zonepools[NUMZONEPOOLS];
+
+
 
 //
 // Z_ClearZone
@@ -89,6 +132,171 @@ void Z_ClearZone (memzone_t* zone)
 
 
 
+//
+// Z_InitPools
+//
+void Z_InitPools (void)
+{
+    int         i;
+    zonepool_t* pool;
+
+    for (i=0, pool=zonepools ; i<NUMZONEPOOLS ; i++, pool++)
+    {
+        pool->slotsize = sizeof(memblock_t) + (i+1)*ZONEPOOLGRAIN;
+        if (i >= ZONELINEPOOLS)
+            pool->slotsize = (pool->slotsize + ZONELINE-1) & ~(ZONELINE-1);
+        pool->used.next = pool->used.prev = &pool->used;
+        pool->free = NULL;
+    }
+}
+
+
+//
+// Z_MallocSlab
+// Takes a PU_STATIC block from the tail of the highest free
+//  block that fits, so slabs pile up at the end of the zone
+//  instead of pinning the middle of it across levels.
+// Falls back to the rover if no free block is big enough.
+//
+void* Z_MallocSlab (int size)
+{
+    memblock_t* block;
+    memblock_t* newblock;
+    int         extra;
+
+    size = ((size + 3) & ~3) + sizeof(memblock_t);
+
+    for (block = mainzone->blocklist.prev ;
+         block != &mainzone->blocklist ;
+         block = block->prev)
+    {
+        if (!block->user && block->size >= size)
+            break;
+    }
+
+    if (block == &mainzone->blocklist)
+        return Z_Malloc (size - sizeof(memblock_t), PU_STATIC, NULL);
+
+    extra = block->size - size;
+
+    if (extra > MINFRAGMENT)
+    {
+        // the free fragment stays in front of the slab
+        newblock = (memblock_t *) ((byte *)block + extra);
+        newblock->size = size;
+        newblock->prev = block;
+        newblock->next = block->next;
+        newblock->next->prev = newblock;
+
+        block->next = newblock;
+        block->size = extra;
+
+        block = newblock;
+    }
+
+    // mark as in use, but unowned
+    block->user = (void *)2;
+    block->tag = PU_STATIC;
+    block->id = ZONEID;
+
+    return (void *) ((byte *)block + sizeof(memblock_t));
+}
+
+
+//
+// Z_RefillPool
+// Carves a new slab into free slots.
+//
+void Z_RefillPool (zonepool_t* pool)
+{
+    byte*       slab;
+    memblock_t* slot;
+    int         count;
+    int         i;
+
+    count = ZONESLABSIZE / pool->slotsize;
+
+    if (pool - zonepools < ZONELINEPOOLS)
+        slab = Z_MallocSlab (count*pool->slotsize);
+    else
+    {
+        // line up the data after the first header
+        slab = Z_MallocSlab (count*pool->slotsize + ZONELINE-4);
+        slab += -(size_t)(slab + sizeof(memblock_t)) & (ZONELINE-1);
+    }
+
+    for (i=0 ; i<count ; i++)
+    {
+        slot = (memblock_t *) (slab + i*pool->slotsize);
+
+        // the class size, which Z_PoolFree finds the pool by
+        slot->size = -(sizeof(memblock_t)
+                       + (pool - zonepools + 1)*ZONEPOOLGRAIN);
+        slot->user = NULL;
+        slot->tag = 0;
+        slot->id = 0;
+        slot->prev = NULL;
+        slot->next = pool->free;
+        pool->free = slot;
+    }
+}
+
+
+//
+// Z_PoolMalloc
+// Slots are always unowned.
+//
+void*
+Z_PoolMalloc
+( zonepool_t*   pool,
+  int           tag )
+{
+    memblock_t* slot;
+
+    if (!pool->free)
+        Z_RefillPool (pool);
+
+    slot = pool->free;
+    pool->free = slot->next;
+
+    // link on the used list
+    slot->prev = &pool->used;
+    slot->next = pool->used.next;
+    slot->next->prev = slot;
+    pool->used.next = slot;
+
+    // mark as in use, but unowned
+    slot->user = (void *)2;
+    slot->tag = tag;
+    slot->id = ZONEID;
+
+    return (void *) ((byte *)slot + sizeof(memblock_t));
+}
+
+
+//
+// Z_PoolFree
+//
+void Z_PoolFree (memblock_t* slot)
+{
+    zonepool_t* pool;
+
+    pool = &zonepools[(-slot->size - sizeof(memblock_t)) / ZONEPOOLGRAIN - 1];
+
+    slot->user = NULL;
+    slot->tag = 0;
+    slot->id = 0;
+
+    slot->prev->next = slot->next;
+    slot->next->prev = slot->prev;
+
+    slot->prev = NULL;
+    slot->next = pool->free;
+    pool->free = slot;
+}
+
+
+
 //
 // Z_Init
 //
@@ -115,6 +323,20 @@ void Z_Init (void)
     block->user = NULL;
 
     block->size = mainzone->size - sizeof(memzone_t);
+
+    Z_InitPools ();
+}
+
+
+//
+// Z_InZone
+// W_CacheLumpNum can return lumps straight out of
+//  a mapped WAD, which callers still free or retag.
+//
+int Z_InZone (void* ptr)
+{
+    return (byte *)ptr > (byte *)mainzone
+        && (byte *)ptr < (byte *)mainzone + mainzone->size;
 }
 
 
@@ -126,11 +348,21 @@ void Z_Free (void* ptr)
     memblock_t*         block;
     memblock_t*         other;
 
+    // mapped lumps were never allocated here
+    if (!Z_InZone (ptr))
+        return;
+
     block = (memblock_t *) ( (byte *)ptr - sizeof(memblock_t));
 
     if (block->id != ZONEID)
         I_Error ("Z_Free: freed a pointer without ZONEID");
 
+    if (block->size < 0)
+    {
+        Z_PoolFree (block);
+        return;
+    }
+
     if (block->user > (void **)0x100)
     {
         // smaller values are not pointers
@@ -179,7 +411,6 @@ void Z_Free (void* ptr)
 // Z_Malloc
 // You can pass a NULL user if the tag is < PU_PURGELEVEL.
 //
-#define MINFRAGMENT             64
 
 
 void*
@@ -196,6 +427,15 @@ Z_Malloc
 
     size = (size + 3) & ~3;
 
+    // small blocks that can never be purged come from the pools
+    if (size > 0
+        && size <= NUMZONEPOOLS*ZONEPOOLGRAIN
+        && !user
+        && tag < PU_PURGELEVEL)
+    {
+        return Z_PoolMalloc (&zonepools[(size-1) / ZONEPOOLGRAIN], tag);
+    }
+
     // scan through the block list,
     // looking for the first free block
     // of sufficient size,
@@ -302,6 +542,7 @@ Z_FreeTags
 {
     memblock_t* block;
     memblock_t* next;
+    zonepool_t* pool;
 
     for (block = mainzone->blocklist.next ;
          block != &mainzone->blocklist ;
@@ -317,6 +558,19 @@ Z_FreeTags
         if (block->tag >= lowtag && block->tag <= hightag)
             Z_Free ( (byte *)block+sizeof(memblock_t));
     }
+
+    for (pool = zonepools ; pool < zonepools+NUMZONEPOOLS ; pool++)
+    {
+        for (block = pool->used.next ;
+             block != &pool->used ;
+             block = next)
+        {
+            next = block->next;
+
+            if (block->tag >= lowtag && block->tag <= hightag)
+                Z_PoolFree (block);
+        }
+    }
 }
 
 
@@ -447,6 +701,33 @@ Z_ChangeTag2
 
 
 
+//
+// Z_GrowArray
+// Moves a growable table to a bigger static
+//  block, keeping the first count entries.
+//
+void*
+Z_GrowArray
+( void*         array,
+  int           count,
+  int           newcount,
+  int           size )
+{
+    void*       newarray;
+
+    newarray = Z_Malloc (newcount*size, PU_STATIC, NULL);
+
+    if (array)
+    {
+        memcpy (newarray, array, count*size);
+        Z_Free (array);
+    }
+
+    return newarray;
+}
+
+
+
 //
 // Z_FreeMemory
 //
@@ -464,6 +745,9 @@ int Z_FreeMemory (void)
         if (!block->user || block->tag >= PU_PURGELEVEL)
             free += block->size;
     }
+
+    // free pool slots are only free for their own size class,
+    //  the slabs themselves show up as static blocks above
     return free;
 }
 
@@ -53,12 +53,15 @@ void    Z_DumpHeap (int lowtag, int hightag);
 void    Z_FileDumpHeap (FILE *f);
 void    Z_CheckHeap (void);
 void    Z_ChangeTag2 (void *ptr, int tag);
+void*   Z_GrowArray (void *array, int count, int newcount, int size);
 int     Z_FreeMemory (void);
+int     Z_InZone (void *ptr);
 
 
 typedef struct memblock_s
 {
-    int                 size;   // including the header and possibly tiny fragments
+    int                 size;   // including the header and possibly tiny fragments,
+                                // negated for small blocks from the size class pools
     void**              user;   // NULL if a free block
     int                 tag;    // purgelevel
     int                 id;     // should be ZONEID
@@ -70,11 +73,17 @@ typedef struct memblock_s
 // This is used to get the local FILE:LINE info from CPP
 // prior to really call the function in question.
 //
+// Pointers outside the zone (lumps in a mapped WAD)
+// are left alone.
+//
 #define Z_ChangeTag(p,t) \
 { \
+    if (Z_InZone(p)) \
+    { \
       if (( (memblock_t *)( (byte *)(p) - sizeof(memblock_t)))->id!=0x1d4a11) \
           I_Error("Z_CT at "__FILE__":%i",__LINE__); \
           Z_ChangeTag2(p,t); \
+    } \
 };
 
 